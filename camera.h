@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "math/frustum.h"
+
 enum Camera_Movement {
 	FOWARD,
 	BACKWARD,
@@ -62,6 +64,12 @@ public:
 		return glm::lookAt(Position, Position + Front, Up);
 	}
 
+	//world space frustum planes for the given projection
+	Frustum GetFrustum(const glm::mat4& projection)
+	{
+		return ExtractFrustum(projection * GetViewMatrix());
+	}
+
 	void ProcessKeyboard(Camera_Movement direction, float deltaTime)
 	{
 		float velocity = MovementSpeed * deltaTime;
@@ -0,0 +1,108 @@
+#include "headlessContext.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+static GLFWwindow* hiddenWindow = nullptr;
+
+bool CreateHeadlessContext(int major, int minor)
+{
+	if (!glfwInit())
+		return false;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	hiddenWindow = glfwCreateWindow(16, 16, "headless", NULL, NULL);
+	if (hiddenWindow == NULL) {
+		std::cout << "ERROR::HEADLESS::WINDOW_CREATION_FAILED" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(hiddenWindow);
+	return true;
+}
+
+void DestroyHeadlessContext()
+{
+	if (hiddenWindow)
+		glfwDestroyWindow(hiddenWindow);
+	hiddenWindow = nullptr;
+	glfwTerminate();
+}
+
+void* HeadlessGetProcAddress(const char* name)
+{
+	return (void*)glfwGetProcAddress(name);
+}
+
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+bool CreateHeadlessContext(int major, int minor)
+{
+	//the surfaceless platform needs no display server, fall back to the default display elsewhere
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint eglMajor, eglMinor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cout << "ERROR::HEADLESS::EGL_NO_DESKTOP_GL" << std::endl;
+		return false;
+	}
+
+	//no surface is ever created, a config is only needed by implementations without EGL_KHR_no_config_context
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, configCount > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+	return true;
+}
+
+void DestroyHeadlessContext()
+{
+	if (display == EGL_NO_DISPLAY)
+		return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+	context = EGL_NO_CONTEXT;
+	display = EGL_NO_DISPLAY;
+}
+
+void* HeadlessGetProcAddress(const char* name)
+{
+	return (void*)eglGetProcAddress(name);
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+//offscreen GL context with no visible window, used by --headless
+//Linux: EGL on Mesa's surfaceless platform, so it runs on llvmpipe without X or Wayland
+//Windows: a hidden GLFW window, its default framebuffer is never presented
+//rendering has to go to an FBO either way (see OffscreenTarget)
+
+bool CreateHeadlessContext(int major, int minor);
+void DestroyHeadlessContext();
+
+//pass to gladLoadGLLoader
+void* HeadlessGetProcAddress(const char* name);
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "workStealingDeque.h"
+#include "profiler.h"
+
+//counts the jobs spawned on it that haven't finished; a job that spawns children on the same counter (before it returns)
+//keeps it above zero, so waiting on it waits for the whole tree
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending{ 0 };
+};
+
+//work-stealing scheduler for per frame engine work (cluster binning, draw recording, transform updates, ...)
+//every worker and the thread that called Start own a Chase-Lev deque: spawns go to the bottom of the spawning thread's
+//deque and are popped from there newest first, idle threads steal the oldest from someone else
+//Wait runs jobs while it waits, so the main thread works instead of blocking, also inside jobs
+//threads that aren't part of the system (the texture loaders) run what they spawn inline
+//blocking work (file reads) belongs on a ThreadPool, a job that sleeps takes a core out of the frame
+class JobSystem
+{
+public:
+	static JobSystem& Get()
+	{
+		static JobSystem instance;
+		return instance;
+	}
+
+	//captures larger than this don't fit a job, capture a pointer to the data instead
+	enum { JOB_STORAGE = 64 };
+
+	~JobSystem() { Shutdown(); }
+
+	//0 picks hardware concurrency minus one (the calling thread is a worker too while it waits)
+	void Start(unsigned int workerCount = 0)
+	{
+		if (!threads.empty() || !slots.empty())
+			return;
+		if (workerCount == 0) {
+			unsigned int hardware = std::thread::hardware_concurrency();
+			workerCount = hardware > 1 ? hardware - 1 : 1;
+		}
+
+		stopping = false;
+		for (unsigned int i = 0; i <= workerCount; i++) {
+			slots.emplace_back(new Slot());
+			slots.back()->seed = 0x9E3779B9u * (i + 1);
+		}
+		threadIndex() = 0;
+
+		for (unsigned int i = 1; i <= workerCount; i++) {
+			threads.emplace_back([this, i]() {
+				threadIndex() = (int)i;
+				Profiler::Get().SetThreadName("Job " + std::to_string(i - 1));
+				workerLoop((int)i);
+			});
+		}
+	}
+
+	//the jobs spawned before have to have been waited for
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads)
+			thread.join();
+		threads.clear();
+
+		for (auto& slot : slots)
+			for (Job* job : slot->freeJobs)
+				delete job;
+		slots.clear();
+		threadIndex() = -1;
+	}
+
+	//threads that run jobs, the one that called Start included
+	size_t ThreadCount() const { return slots.size(); }
+
+	template <typename F>
+	void Spawn(JobCounter& counter, F&& function)
+	{
+		typedef typename std::decay<F>::type Function;
+		static_assert(sizeof(Function) <= JOB_STORAGE, "job capture too large, capture a pointer to the data instead");
+		static_assert(alignof(Function) <= alignof(std::max_align_t), "job capture over-aligned");
+
+		int index = threadIndex();
+		if (index < 0 || index >= (int)slots.size()) {
+			function();
+			return;
+		}
+
+		Slot& slot = *slots[index];
+		Job* job = slot.freeJobs.empty() ? new Job() : slot.freeJobs.back();
+		if (!slot.freeJobs.empty())
+			slot.freeJobs.pop_back();
+		new (job->storage) Function(std::forward<F>(function));
+		job->run = [](Job& self) {
+			Function& stored = *reinterpret_cast<Function*>(self.storage);
+			stored();
+			stored.~Function();
+		};
+		job->counter = &counter;
+
+		//counted before it can be taken, so queued never dips below zero
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		queued.fetch_add(1, std::memory_order_seq_cst);
+		slot.deque.Push(job);
+		if (sleeping.load(std::memory_order_seq_cst) > 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			wake.notify_one();
+		}
+	}
+
+	//runs other jobs until everything spawned on counter has finished
+	void Wait(const JobCounter& counter)
+	{
+		int index = threadIndex();
+		while (!counter.Done()) {
+			if (index < 0 || !runOne(index))
+				std::this_thread::yield();
+		}
+	}
+
+	//job(begin, end) over [0, count) in grain sized ranges; the range is halved recursively, each half a job, so idle
+	//threads steal big pieces instead of queueing count / grain tiny ones; returns when all of it is done
+	template <typename F>
+	void ParallelFor(size_t count, size_t grain, const F& job)
+	{
+		if (count == 0)
+			return;
+		grain = std::max(grain, (size_t)1);
+		JobCounter counter;
+		split(counter, 0, (count + grain - 1) / grain, count, grain, &job);
+		Wait(counter);
+	}
+
+private:
+	struct Job {
+		void (*run)(Job&) = nullptr;
+		JobCounter* counter = nullptr;
+		alignas(std::max_align_t) unsigned char storage[JOB_STORAGE];
+	};
+
+	//per thread, index 0 is the one that called Start
+	struct Slot {
+		WorkStealingDeque<Job> deque;
+		std::vector<Job*> freeJobs;		//jobs this thread ran, reused for the next spawns
+		uint32_t seed = 0;				//victim order
+	};
+
+	enum { SPIN_ATTEMPTS = 64, MAX_FREE_JOBS = 4096 };
+
+	JobSystem() = default;
+
+	std::vector<std::unique_ptr<Slot>> slots;
+	std::vector<std::thread> threads;
+	std::atomic<int> queued{ 0 };		//spawned and not yet taken by anyone, what sleeping workers wait for
+	std::atomic<int> sleeping{ 0 };
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	static int& threadIndex()
+	{
+		static thread_local int index = -1;
+		return index;
+	}
+
+	template <typename F>
+	void split(JobCounter& counter, size_t first, size_t last, size_t count, size_t grain, const F* job)
+	{
+		while (last - first > 1) {
+			size_t middle = first + (last - first) / 2;
+			Spawn(counter, [this, &counter, middle, last, count, grain, job]() {
+				split(counter, middle, last, count, grain, job);
+			});
+			last = middle;
+		}
+		(*job)(first * grain, std::min((first + 1) * grain, count));
+	}
+
+	Job* take(int index)
+	{
+		Slot& slot = *slots[index];
+		Job* job = slot.deque.Pop();
+		if (!job) {
+			//xorshift start, then every other thread once
+			slot.seed ^= slot.seed << 13;
+			slot.seed ^= slot.seed >> 17;
+			slot.seed ^= slot.seed << 5;
+			size_t count = slots.size();
+			size_t start = slot.seed % count;
+			for (size_t i = 0; i < count && !job; i++) {
+				size_t victim = (start + i) % count;
+				if ((int)victim != index)
+					job = slots[victim]->deque.Steal();
+			}
+		}
+		if (job)
+			queued.fetch_sub(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	bool runOne(int index)
+	{
+		Job* job = take(index);
+		if (!job)
+			return false;
+
+		JobCounter* counter = job->counter;
+		job->run(*job);
+
+		Slot& slot = *slots[index];
+		if (slot.freeJobs.size() < MAX_FREE_JOBS)
+			slot.freeJobs.push_back(job);
+		else
+			delete job;
+		counter->pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void workerLoop(int index)
+	{
+		int idle = 0;
+		while (true) {
+			if (runOne(index)) {
+				idle = 0;
+				continue;
+			}
+			if (++idle < SPIN_ATTEMPTS) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			//spawners bump queued before they look at sleeping, and we count ourselves before looking at queued,
+			//so one of the two sides always sees the other
+			std::unique_lock<std::mutex> lock(mutex);
+			sleeping.fetch_add(1, std::memory_order_seq_cst);
+			wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+			sleeping.fetch_sub(1, std::memory_order_seq_cst);
+			if (stopping && queued.load(std::memory_order_seq_cst) == 0)
+				return;
+			idle = 0;
+		}
+	}
+};
+
+#endif
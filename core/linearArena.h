@@ -0,0 +1,83 @@
+#ifndef LINEAR_ARENA_H
+#define LINEAR_ARENA_H
+
+#include <memory>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+
+//bump allocator for per frame data: Allocate hands out aligned slices of big blocks, Reset frees all of it at once
+//blocks are kept for the next frame and never move, so pointers stay valid until Reset
+//not synchronised, every thread records into its own arena
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	//alignment has to be a power of two no larger than the one new[] guarantees
+	void* Allocate(size_t size, size_t alignment)
+	{
+		while (current < blocks.size()) {
+			size_t start = (offset + alignment - 1) & ~(alignment - 1);
+			if (start + size <= blocks[current].size) {
+				offset = start + size;
+				used += size;
+				return blocks[current].data.get() + start;
+			}
+			current++;
+			offset = 0;
+		}
+
+		//a new block, at least as big as the request
+		Block block;
+		block.size = size > blockSize ? size : blockSize;
+		block.data.reset(new char[block.size]);
+		blocks.push_back(std::move(block));
+		current = blocks.size() - 1;
+		offset = size;
+		used += size;
+		return blocks[current].data.get();
+	}
+
+	//only for types that need no destructor, nothing is destroyed on Reset
+	template <typename T>
+	T* Allocate()
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "LinearArena never runs destructors");
+		return new (Allocate(sizeof(T), alignof(T))) T();
+	}
+
+	void Reset()
+	{
+		current = 0;
+		offset = 0;
+		used = 0;
+	}
+
+	size_t Used() const { return used; }
+	size_t Capacity() const
+	{
+		size_t capacity = 0;
+		for (const Block& block : blocks)
+			capacity += block.size;
+		return capacity;
+	}
+
+private:
+	struct Block {
+		std::unique_ptr<char[]> data;
+		size_t size = 0;
+	};
+
+	std::vector<Block> blocks;
+	size_t blockSize;
+	size_t current = 0;
+	size_t offset = 0;
+	size_t used = 0;
+};
+
+#endif
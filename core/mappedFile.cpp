@@ -0,0 +1,130 @@
+#include "mappedFile.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const unsigned char*>(view);
+	size = (size_t)fileSize.QuadPart;
+#else
+	int handle = ::open(path.c_str(), O_RDONLY);
+	if (handle < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(handle, &info) != 0 || info.st_size == 0) {
+		::close(handle);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+	if (view == MAP_FAILED) {
+		::close(handle);
+		return false;
+	}
+
+	fd = handle;
+	data = static_cast<const unsigned char*>(view);
+	size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(data), size);
+	::close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+bool GetFileStamp(const std::string& path, FileStamp& stamp)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#endif
+	stamp.size = (uint64_t)info.st_size;
+	stamp.modified = (int64_t)info.st_mtime;
+	return true;
+}
+
+bool MakeDirectory(const std::string& path)
+{
+	//every prefix ending at a separator, then the whole path; the ones that already exist just fail to be created
+	for (size_t i = 1; i <= path.size(); i++) {
+		if (i < path.size() && path[i] != '/' && path[i] != '\\')
+			continue;
+		std::string prefix = path.substr(0, i);
+#ifdef _WIN32
+		_mkdir(prefix.c_str());
+#else
+		mkdir(prefix.c_str(), 0755);
+#endif
+	}
+
+#ifdef _WIN32
+	struct _stat64 info;
+	return _stat64(path.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR) != 0;
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+//read-only memory mapping of a whole file (MapViewOfFile on Windows, mmap elsewhere)
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+	bool IsOpen() const { return data != nullptr; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+//size + modification time, used to tell whether a derived cache file is stale
+struct FileStamp {
+	uint64_t size = 0;
+	int64_t modified = 0;
+
+	bool operator==(const FileStamp& other) const { return size == other.size && modified == other.modified; }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+bool GetFileStamp(const std::string& path, FileStamp& stamp);
+
+//creates the directory and any missing parents, true when it exists afterwards
+bool MakeDirectory(const std::string& path);
+
+#endif
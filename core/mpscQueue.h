@@ -0,0 +1,62 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+//unbounded lock-free multi producer / single consumer queue (Vyukov's intrusive node queue)
+//any thread may Push, only one thread may TryPop
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+	{
+		Node* stub = new Node();
+		head.store(stub, std::memory_order_relaxed);
+		tail = stub;
+	}
+
+	~MpscQueue()
+	{
+		T discarded;
+		while (TryPop(discarded)) {}
+		delete tail;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(T value)
+	{
+		Node* node = new Node();
+		node->value = std::move(value);
+		//swap ourselves in as the newest node, then link the previous one to us
+		Node* previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	//false when empty, or when a producer is between its exchange and its link (it shows up next call)
+	bool TryPop(T& out)
+	{
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+
+		out = std::move(next->value);
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node*> next{ nullptr };
+		T value{};
+	};
+
+	std::atomic<Node*> head;	//producers
+	Node* tail;					//consumer, always the already consumed stub
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//lightweight CPU instrumentation
+//PROFILE_SCOPE("name") times the enclosing block; every thread writes finished scopes into its own ring buffer without locking
+//the main thread drains all rings once per frame (EndFrame) and keeps that frame's events plus per-name totals for display
+//define PROFILER_DISABLED to compile every scope out
+
+struct ProfileEvent {
+	const char* name;		//must be a string literal or otherwise outlive the profiler
+	int64_t start;			//nanoseconds on the profiler clock
+	int64_t end;
+	uint32_t depth;			//nesting level inside its thread
+	uint32_t thread;		//index into Profiler::ThreadNames
+};
+
+//single producer (the owning thread) / single consumer (EndFrame) ring
+//when it is full the new events are dropped (and counted), the producer never blocks and never overwrites a slot the
+//consumer hasn't released, so a copy can't be torn
+class ProfileThreadBuffer
+{
+public:
+	static const uint32_t CAPACITY = 4096;
+
+	ProfileEvent events[CAPACITY];
+	std::atomic<uint32_t> written{ 0 };
+	std::atomic<uint32_t> read{ 0 };		//stored by the consumer once the slots before it are copied
+	std::atomic<uint32_t> dropped{ 0 };		//since the consumer last took the count
+	uint32_t depth = 0;			//producer side only
+	uint32_t index = 0;
+
+	void Push(const ProfileEvent& event)
+	{
+		uint32_t slot = written.load(std::memory_order_relaxed);
+		if (slot - read.load(std::memory_order_acquire) >= CAPACITY) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		events[slot % CAPACITY] = event;
+		written.store(slot + 1, std::memory_order_release);
+	}
+};
+
+struct ProfileTotal {
+	const char* name;
+	double milliseconds;
+	int calls;
+};
+
+class Profiler
+{
+public:
+	static Profiler& Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//names the calling thread in the timeline, optional (unnamed threads show up as "Thread N")
+	void SetThreadName(const std::string& name)
+	{
+		ProfileThreadBuffer& buffer = ThreadBuffer();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadNames[buffer.index] = name;
+	}
+
+	ProfileThreadBuffer& ThreadBuffer()
+	{
+		static thread_local ProfileThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffers.emplace_back(new ProfileThreadBuffer());
+			buffer = buffers.back().get();
+			buffer->index = (uint32_t)(buffers.size() - 1);
+			threadNames.push_back("Thread " + std::to_string(buffer->index));
+		}
+		return *buffer;
+	}
+
+	void BeginFrame()
+	{
+		frameStart = Now();
+	}
+
+	//collects every event finished since the last call and rebuilds the frame view
+	void EndFrame()
+	{
+		int64_t frameEnd = Now();
+
+		std::vector<ProfileThreadBuffer*> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			for (auto& buffer : buffers)
+				snapshot.push_back(buffer.get());
+			LastFrameThreadNames = threadNames;
+		}
+
+		LastFrameEvents.clear();
+		for (ProfileThreadBuffer* buffer : snapshot) {
+			uint32_t written = buffer->written.load(std::memory_order_acquire);
+			uint32_t read = buffer->read.load(std::memory_order_relaxed);
+			for (; read != written; read++) {
+				ProfileEvent event = buffer->events[read % ProfileThreadBuffer::CAPACITY];
+				event.thread = buffer->index;
+				LastFrameEvents.push_back(event);
+			}
+			//hands the copied slots back to the producer
+			buffer->read.store(read, std::memory_order_release);
+			DroppedEvents += buffer->dropped.exchange(0, std::memory_order_relaxed);
+		}
+
+		LastFrameTotals.clear();
+		for (const ProfileEvent& event : LastFrameEvents) {
+			ProfileTotal* total = nullptr;
+			for (ProfileTotal& existing : LastFrameTotals) {
+				if (existing.name == event.name) {
+					total = &existing;
+					break;
+				}
+			}
+			if (!total) {
+				LastFrameTotals.push_back({ event.name, 0.0, 0 });
+				total = &LastFrameTotals.back();
+			}
+			total->milliseconds += (event.end - event.start) / 1e6;
+			total->calls++;
+		}
+
+		LastFrameStart = frameStart;
+		LastFrameEnd = frameEnd;
+	}
+
+	//previous frame, valid until the next EndFrame
+	std::vector<ProfileEvent> LastFrameEvents;
+	std::vector<ProfileTotal> LastFrameTotals;
+	std::vector<std::string> LastFrameThreadNames;
+	int64_t LastFrameStart = 0;
+	int64_t LastFrameEnd = 0;
+	uint64_t DroppedEvents = 0;
+
+private:
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers;	//never shrinks, threads keep raw pointers
+	std::vector<std::string> threadNames;
+	int64_t frameStart = 0;
+};
+
+//times from construction to End() or destruction
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: buffer(Profiler::Get().ThreadBuffer()), name(name), depth(buffer.depth++), start(Profiler::Now())
+	{
+	}
+
+	~ProfileScope() { End(); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	//ends the scope early, for spans that don't line up with a block
+	void End()
+	{
+		if (!name) return;
+		ProfileEvent event = { name, start, Profiler::Now(), depth, 0 };
+		buffer.Push(event);
+		buffer.depth--;
+		name = nullptr;
+	}
+
+private:
+	ProfileThreadBuffer& buffer;
+	const char* name;
+	uint32_t depth;
+	int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef PROFILER_DISABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif
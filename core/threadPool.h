@@ -0,0 +1,134 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "profiler.h"
+
+//fixed set of worker threads pulling jobs from one shared FIFO
+class ThreadPool
+{
+public:
+	ThreadPool() = default;
+	~ThreadPool() { Shutdown(); }
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//0 picks hardware concurrency minus one (the render thread keeps a core)
+	//workers show up in the profiler as "<name> <index>"
+	void Start(unsigned int threadCount = 0, const std::string& name = "Worker")
+	{
+		if (threadCount == 0) {
+			unsigned int hardware = std::thread::hardware_concurrency();
+			threadCount = hardware > 1 ? hardware - 1 : 1;
+		}
+
+		stopping = false;
+		for (unsigned int i = 0; i < threadCount; i++) {
+			std::string threadName = name + " " + std::to_string(i);
+			workers.emplace_back([this, threadName]() {
+				Profiler::Get().SetThreadName(threadName);
+				workerLoop();
+			});
+		}
+	}
+
+	//finishes the jobs already queued, then joins
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	void Submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		wake.notify_one();
+	}
+
+	//runs job(0) .. job(count - 1) on the workers and the calling thread, returns once every index finished
+	//indices are claimed one at a time, so the caller never waits on a worker that is still busy with an older job
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job)
+	{
+		if (count == 0) return;
+
+		//shared, a worker can pick up its (by then empty) share after this call returned
+		auto batch = std::make_shared<Batch>();
+		batch->count = count;
+		batch->job = &job;
+
+		auto run = [batch]() {
+			size_t index;
+			while ((index = batch->next.fetch_add(1)) < batch->count) {
+				(*batch->job)(index);
+				if (batch->done.fetch_add(1) + 1 == batch->count) {
+					{ std::lock_guard<std::mutex> lock(batch->mutex); }
+					batch->finished.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min(workers.size(), count - 1);
+		for (size_t i = 0; i < helpers; i++)
+			Submit(run);
+		run();
+
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->finished.wait(lock, [&batch]() { return batch->done.load() == batch->count; });
+	}
+
+	size_t ThreadCount() const { return workers.size(); }
+
+private:
+	struct Batch {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		size_t count = 0;
+		const std::function<void(size_t)>* job = nullptr;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop()
+	{
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+//Chase-Lev deque of pointers (the C11 formulation by Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+//the owning thread pushes and pops at the bottom, any thread may Steal from the top
+//the orderings that matter are seq_cst operations instead of standalone fences, which ThreadSanitizer understands;
+//on x86 that costs the same, bottom stores are at least release so a thief that sees an element also sees what it points to
+//the ring grows when full; replaced rings are kept until destruction since a thief may still be reading one
+template <typename T>
+class WorkStealingDeque
+{
+public:
+	explicit WorkStealingDeque(size_t capacity = 1024)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		rings.emplace_back(new Ring(size));
+		ring.store(rings.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	//owner only
+	void Push(T* item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		Ring* current = ring.load(std::memory_order_relaxed);
+		if (b - t > (int64_t)current->mask)
+			current = grow(current, t, b);
+		current->slots[b & current->mask].store(item, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	//owner only, newest first; null when empty or a thief took the last one
+	T* Pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Ring* current = ring.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_seq_cst);
+
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_release);
+			return nullptr;
+		}
+
+		T* item = current->slots[b & current->mask].load(std::memory_order_relaxed);
+		if (t == b) {
+			//the last element, thieves may be going for it too
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				item = nullptr;
+			bottom.store(b + 1, std::memory_order_release);
+		}
+		return item;
+	}
+
+	//any thread, oldest first; null when empty or when it lost the race for the element (try another victim)
+	T* Steal()
+	{
+		int64_t t = top.load(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_seq_cst);
+		if (t >= b)
+			return nullptr;
+
+		Ring* current = ring.load(std::memory_order_acquire);
+		T* item = current->slots[t & current->mask].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return item;
+	}
+
+	//a snapshot, only exact on the owning thread while nobody steals
+	bool Empty() const
+	{
+		return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Ring {
+		explicit Ring(size_t size) : mask(size - 1), slots(new std::atomic<T*>[size]) {}
+		size_t mask;
+		std::unique_ptr<std::atomic<T*>[]> slots;
+	};
+
+	Ring* grow(Ring* old, int64_t t, int64_t b)
+	{
+		rings.emplace_back(new Ring((old->mask + 1) * 2));
+		Ring* bigger = rings.back().get();
+		for (int64_t i = t; i < b; i++)
+			bigger->slots[i & bigger->mask].store(old->slots[i & old->mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		ring.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+
+	std::atomic<int64_t> top{ 0 };
+	std::atomic<int64_t> bottom{ 0 };
+	std::atomic<Ring*> ring{ nullptr };
+	std::vector<std::unique_ptr<Ring>> rings;		//owner only, every ring ever used
+};
+
+#endif
@@ -7,6 +7,27 @@
 #include <GLFW/glfw3.h>
 
 #include "shaders/shader.h"
+#include "shaders/shaderVariants.h"
+#include "renderer/lightBlock.h"
+#include "renderer/lightClusters.h"
+#include "renderer/gBuffer.h"
+#include "renderer/glState.h"
+#include "renderer/instanceBuffer.h"
+#include "renderer/renderQueue.h"
+#include "renderer/textureManager.h"
+#include "math/normalMatrix.h"
+#include "math/sphereCulling.h"
+#include "math/aabbTree.h"
+#include "math/transformHierarchy.h"
+#include "mesh/mesh.h"
+#include "mesh/model.h"
+#include "core/profiler.h"
+#include "core/jobSystem.h"
+#include "renderer/gpuProfiler.h"
+#include "renderer/offscreenTarget.h"
+#include "renderer/debugDraw.h"
+#include "renderer/imageCompare.h"
+#include "core/headlessContext.h"
 #include "libs/stb_image.h"
 
 #include "camera.h"
@@ -14,12 +35,21 @@
 #include "libs/glm/glm.hpp"
 #include "libs/glm/gtc/matrix_transform.hpp"
 #include "libs/glm/gtc/type_ptr.hpp"
+#include "libs/glm/gtx/intersect.hpp"
+#include "libs/glm/gtx/component_wise.hpp"
 
 #include <imGui/imgui.h>
 #include <imGui/backends/imgui_impl_glfw.h>
 #include <imGui/backends/imgui_impl_opengl3.h>
 
 #include <vector>
+#include <cmath>
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+#include <unordered_map>
+#include <functional>
+#include <tuple>
 
 using namespace std;
 
@@ -29,18 +59,45 @@ void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
 void processInput(GLFWwindow* window);
 void SetLightsToShader(Shader& cubeShader);
 void RenderLightEditor();
+void ScatterLights(int count);
+void AnimateLights();
+void UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection);
+void SetLightingUniforms(Shader& shader);
+uint32_t ActiveShaderFeatures();
+void RenderProfilerTimeline();
+void AddCubeTransforms(TransformHierarchy& transforms, int count, const glm::vec3* basePositions, int baseCount);
+void SyncLightTransforms();
+void BuildCubeInstances(const glm::mat4* models, size_t count, std::vector<InstanceData>& instances);
+void BuildCubeBounds(const glm::mat4* models, size_t count, BoundingSpheres& bounds);
+void BuildLightInstances(const std::vector<uint32_t>& lights, std::vector<InstanceData>& instances);
+void CullObjects(const Frustum& frustum, const BoundingSpheres& bounds, std::vector<uint32_t>& visible);
+void BuildSceneTree(const glm::mat4* models, size_t count);
+void SyncLightProxies();
+void CullSceneTree(const Frustum& frustum);
+void PickObject(const glm::vec2& cursor, const glm::mat4& projection, const glm::mat4& view);
+void AddDebugBox(const AABB& box, glm::vec3 color);
+MeshData BuildCubeMesh(bool optimizeVertexCache);
+int RunMeshStats();
+int RunMeshLoadBenchmark(const std::string& objPath);
+int RunTextureCook(const std::vector<std::string>& paths);
+int RunCullingBenchmark();
+int RunTreeBenchmark(size_t count);
+int RunJobBenchmark();
+int RunTransformBenchmark(size_t count);
+int RunUniformBenchmark();
 //debug funcs
 void AddDebugLine(glm::vec3 from, glm::vec3 to, glm::vec3 color);
-void InitDebugLines();
-void RenderDebugLines(Shader debugShader, glm::mat4 view, glm::mat4 projection);
-void ShowLightFromSurface(glm::vec3 lightDir, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const glm::mat4& model);
-std::vector<glm::vec3> ExtractPositions(const float* vertices, size_t count);
-std::vector<glm::vec3> ExtractNormals(const float* vertices, size_t count);
-void ShowNormals(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const glm::mat4& model);
+void InitDebugLines(GLADloadproc loader);
+void RenderDebugLines(Shader& debugShader, glm::mat4 view, glm::mat4 projection);
 
 //settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.0f;
+
+//current framebuffer, the light clusters are tiled in pixels
+glm::ivec2 framebufferSize(SCR_WIDTH, SCR_HEIGHT);
 
 //camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -60,12 +117,11 @@ static float timeScale = 1.0f;
 //light pos
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-//n of point lights
-const int POINT_LIGHT_AMOUNT = 4;
-
 //mouse toggle var
 bool cursorVisible = false;
 static bool tabPressedLastFrame = false;
+static bool clickPressedLastFrame = false;
+static bool wireframeKeyHeld = false;		//P shows wireframe while held
 
 //light struct
 
@@ -78,9 +134,12 @@ struct LightSettings {
 	float linear = 0.09f;
 	float quadratic = 0.032f;
 	bool enabled = true;
+	float orbitRadius = 0.0f;		//scattered lights circle their anchor while Animate Lights is on
+	glm::vec3 anchor = glm::vec3(0.0f);
 };
 
-LightSettings pointLights[POINT_LIGHT_AMOUNT] = {
+//point lights, capacity comes from LightBlock::MAX_POINT_LIGHTS
+std::vector<LightSettings> pointLights = {
 	{ glm::vec3(1.2f, 1.0f, 2.0f) },
 	{ glm::vec3(2.0f, 1.0f, -3.0f) },
 	{ glm::vec3(-1.0f, 2.0f, 1.0f) },
@@ -89,116 +148,398 @@ LightSettings pointLights[POINT_LIGHT_AMOUNT] = {
 
 int selectedLight = 0;
 
+//GPU side of the lights, only re-uploaded when the editor changes something
+LightBlock lightBlock;
+
+//per cluster light lists, rebuilt every frame from the enabled lights and their ranges
+LightClusters lightClusters;
+BoundingSpheres clusterLightBounds;
+std::vector<uint32_t> clusterLightOwners;
+bool animateLights = false;
+
+//the directional light stays in the LightBlock, switching it off only drops it from the shaders
+bool dirLightEnabled = true;
+
+//spot light that follows the camera, off unless turned on in the light editor
+struct FlashlightSettings {
+	bool enabled = false;
+	glm::vec3 ambient = glm::vec3(0.1f);
+	glm::vec3 diffuse = glm::vec3(0.8f);
+	glm::vec3 specular = glm::vec3(0.3f);
+	float cutOff = 12.5f;			//degrees
+	float outerCutOff = 17.5f;
+};
+FlashlightSettings flashlight;
+
+//lighting shader features, each bit is one #define in the variant it selects (see ActiveShaderFeatures)
+enum ShaderFeature {
+	FEATURE_INSTANCED = 1 << 0,
+	FEATURE_DIR_LIGHT = 1 << 1,
+	FEATURE_POINT_LIGHTS = 1 << 2,
+	FEATURE_SPOT_LIGHT = 1 << 3,
+	FEATURE_SPECULAR_MAP = 1 << 4,
+	FEATURE_CLUSTER_HEATMAP = 1 << 5
+};
+const std::vector<const char*> shaderFeatureNames = { "INSTANCED", "DIR_LIGHT", "POINT_LIGHTS", "SPOT_LIGHT", "SPECULAR_MAP", "CLUSTER_HEATMAP" };
+
+//texture units of the light texture buffers, 0 and 1 are the material maps
+const int POINT_LIGHT_UNIT = 2;
+const int CLUSTER_GRID_UNIT = 3;
+const int CLUSTER_INDEX_UNIT = 4;
+const int GBUFFER_UNIT = 5;		//5..7, albedo/specular, normal, depth
+
+//deferred path, sized to the framebuffer on first use
+GBuffer gBuffer;
+
+//uniform ids, hashed once so the per frame setters skip string building
+const UniformId U_MODEL = UniformName("model");
+const UniformId U_NORMAL_MATRIX = UniformName("normalMatrix");
+const UniformId U_VIEW = UniformName("view");
+const UniformId U_PROJECTION = UniformName("projection");
+const UniformId U_VIEW_POS = UniformName("viewPos");
+const UniformId U_DIFFUSE_COLOR = UniformName("DiffuseColor");
+const UniformId U_MATERIAL_DIFFUSE = UniformName("material.diffuse");
+const UniformId U_MATERIAL_SPECULAR = UniformName("material.specular");
+const UniformId U_SHOW_NORMALS = UniformName("showNormals");
+const UniformId U_SHOW_LIGHT_DIRS = UniformName("showLightDirs");
+const UniformId U_LIGHT_DIRECTION = UniformName("lightDirection");
+const UniformId U_CLUSTER_SCALE = UniformName("clusterScale");
+const UniformId U_CLUSTER_DEPTH = UniformName("clusterDepth");
+const UniformId U_SPOT_POSITION = UniformName("spotLight.position");
+const UniformId U_SPOT_DIRECTION = UniformName("spotLight.direction");
+const UniformId U_SPOT_CUT_OFF = UniformName("spotLight.cutOff");
+const UniformId U_SPOT_OUTER_CUT_OFF = UniformName("spotLight.outerCutOff");
+const UniformId U_SPOT_AMBIENT = UniformName("spotLight.ambient");
+const UniformId U_SPOT_DIFFUSE = UniformName("spotLight.diffuse");
+const UniformId U_SPOT_SPECULAR = UniformName("spotLight.specular");
+const UniformId U_INVERSE_VIEW_PROJECTION = UniformName("inverseViewProjection");
+
+//distance at which the light stops counting, the shader fades it to zero there and the clusters use it as the radius
+float LightRange(const LightSettings& light) {
+	float brightness = std::max(glm::compMax(light.ambient), std::max(glm::compMax(light.diffuse), glm::compMax(light.specular)));
+	return std::min(PointLightRange(light.constant, light.linear, light.quadratic, brightness), CAMERA_FAR);
+}
+
+PointLightStd140 PackPointLight(const LightSettings& light) {
+	PointLightStd140 packed = {};
+	packed.position = light.position;
+	packed.constant = light.constant;
+	packed.ambient = light.ambient;
+	packed.linear = light.linear;
+	packed.diffuse = light.diffuse;
+	packed.quadratic = light.quadratic;
+	packed.specular = light.specular;
+	packed.range = light.enabled ? LightRange(light) : 0.0f;
+	return packed;
+}
+
 //debug settings
 struct DebugSettings {
 	bool showLightDirs = false;
 	bool showNormals = false;
 	bool showWireframe = false;
+	bool instancedRendering = true;
+	int cullMode = 2;		//CullMode
+	bool clusterHeatmap = false;
+	bool specularMaps = true;
+	int renderPath = 0;		//RenderPath
+	int cubeCount = 10;
 };
 DebugSettings debug;
-GLuint debugVAO;
-GLuint debugVBO[2];
 
-std::vector<glm::vec3> debugLineVerts;
-std::vector<glm::vec3> debugLineColors;
-std::vector<glm::vec3> positions;
-std::vector<glm::vec3> normals;
+enum CullMode { CULL_OFF, CULL_LINEAR, CULL_TREE };
+const char* cullModeNames[] = { "Off", "Linear (SIMD spheres)", "AABB tree" };
+
+enum RenderPath { PATH_FORWARD, PATH_DEFERRED };
+const char* renderPathNames[] = { "Forward (clustered)", "Deferred (G-buffer)" };
+
+//per frame counters shown in the Performance window
+struct FrameStats {
+	int drawCalls = 0;
+	size_t bytesUploaded = 0;
+	int objectsVisible = 0;
+	int objectsCulled = 0;
+	int transformsUpdated = 0;	//world matrices TransformHierarchy::Update recomputed
+	int glCallsIssued = 0;		//state changes and binds that reached GL
+	int glCallsElided = 0;		//and the ones GLState found redundant
+	int queuedDraws = 0;			//packets through the render queue
+	int recordChunks = 0;			//recorded in parallel, RenderQueue::RECORD_CHUNK draws each
+	int programChanges = 0;		//state switches between neighbouring sorted packets
+	int materialChanges = 0;
+	int vertexArrayChanges = 0;
+};
+FrameStats frameStats;
+
+//scene transforms, rebuilt only when the cube count changes
+//every object's world matrix: the cubes are nodes [0, cubeNodeCount), one node per point light follows
+TransformHierarchy sceneTransforms;
+uint32_t cubeNodeCount = 0;
+std::vector<InstanceData> cubeInstanceData;
+InstanceBuffer cubeInstances;
+InstanceBuffer lightInstances;
+
+//bounding spheres, cubes change with the cube count, lights are gathered every frame
+//the instance buffers hold only the visible objects and are refilled when that set changes
+const float CUBE_BOUNDING_RADIUS = 0.8660254f;		//half diagonal of the unit cube
+BoundingSpheres cubeBounds;
+BoundingSpheres lightBounds;
+std::vector<uint32_t> lightBoundOwners;
+std::vector<uint32_t> visibleCubes, uploadedCubes;
+std::vector<uint32_t> visibleLights, uploadedLights;
+bool cubeInstancesDirty = true;
+
+//every cube and enabled light, rebuilt with SAH when the cube count changes, lights are reinserted as they move
+//user data is the cube index, or the light index with LIGHT_PROXY_BIT set
+const uint32_t LIGHT_PROXY_BIT = 0x80000000u;
+AABBTree sceneTree;
+std::vector<int> cubeProxies;
+std::vector<int> lightProxies;
+
+//click picking while the cursor is visible, the click is resolved once the frame's matrices exist
+struct PickState {
+	bool pending = false;
+	glm::vec2 cursor;		//0..1, origin bottom left
+	bool hit = false;
+	uint32_t object = 0;
+	float distance = 0.0f;
+};
+PickState pick;
+bool lightInstancesDirty = true;
+
+//--model <file.obj>
+const char* modelPath = nullptr;
+
+//--program-cache <dir>: where linked program binaries are kept, windowed runs default to shader_cache,
+//headless ones only use a cache when given one so timings start cold unless asked otherwise
+const char* programCachePath = nullptr;
+
+//--lights <count>: extra animated lights scattered at startup, with --headless this times the clustered lighting
+int startupLights = 0;
+
+//--headless: fixed number of offscreen frames at a fixed timestep, then a JSON timing report
+struct HeadlessSettings {
+	bool enabled = false;
+	int frames = 100;
+	std::string reportPath = "headless_timings.json";
+	std::string dumpPath;		//--dump <file.ppm>, last frame
+	std::string goldenPath;		//--golden <image>, compared against the last frame
+	double tolerance = 0.5;		//--tolerance <percent of pixels above one JND>
+};
+HeadlessSettings headless;
+
+struct HeadlessFrame {
+	double cpuMilliseconds;
+	double gpuMilliseconds;		//GpuProfiler result available at this frame, FRAME_LATENCY - 1 frames old
+	std::vector<ProfileTotal> cpuScopes;
+	std::vector<GpuProfiler::PassResult> gpuPasses;
+	int glCallsIssued;
+	int glCallsElided;
+	int drawCalls;
+	size_t bytesUploaded;		//instance, light, cluster, debug line and texture data plus per draw uniforms
+};
+bool WriteHeadlessReport(const std::string& path, const std::vector<HeadlessFrame>& frames, const ImageDiff* golden);
+int CompareWithGolden(const std::vector<unsigned char>& rgb, int width, int height, ImageDiff& diff);
+DebugDraw debugDraw;
+
+
+//cube triangle soup, welded into an indexed mesh at startup (BuildCubeMesh)
+const float cubeVertices[] = {
+	// positions          // normals           // texture coords
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
+
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+};
 
 //--
 
-int main() {
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--mesh-stats") == 0)
+			return RunMeshStats();
+		if (std::strcmp(argv[i], "--cull-bench") == 0)
+			return RunCullingBenchmark();
+		if (std::strcmp(argv[i], "--bvh-bench") == 0)
+			return RunTreeBenchmark(i + 1 < argc ? (size_t)std::atoll(argv[i + 1]) : 1000000);
+		if (std::strcmp(argv[i], "--job-bench") == 0)
+			return RunJobBenchmark();
+		if (std::strcmp(argv[i], "--transform-bench") == 0)
+			return RunTransformBenchmark(i + 1 < argc ? (size_t)std::atoll(argv[i + 1]) : 1000000);
+		if (std::strcmp(argv[i], "--uniform-bench") == 0)
+			return RunUniformBenchmark();
+		if (std::strcmp(argv[i], "--mesh-load-bench") == 0)
+			return RunMeshLoadBenchmark(i + 1 < argc ? argv[i + 1] : "bench_sphere.obj");
+		if (std::strcmp(argv[i], "--cook-textures") == 0) {
+			std::vector<std::string> paths(argv + i + 1, argv + argc);
+			if (paths.empty())
+				paths = { "container2.png", "container2_specular.png" };
+			return RunTextureCook(paths);
+		}
+		if (std::strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+			modelPath = argv[++i];
+		else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+			startupLights = std::max(0, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--cubes") == 0 && i + 1 < argc)
+			debug.cubeCount = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--program-cache") == 0 && i + 1 < argc)
+			programCachePath = argv[++i];
+		else if (std::strcmp(argv[i], "--no-instancing") == 0)
+			debug.instancedRendering = false;
+		else if (std::strcmp(argv[i], "--deferred") == 0)
+			debug.renderPath = PATH_DEFERRED;
+		else if (std::strcmp(argv[i], "--headless") == 0)
+			headless.enabled = true;
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			headless.frames = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+			headless.reportPath = argv[++i];
+		else if (std::strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+			headless.dumpPath = argv[++i];
+		else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+			headless.goldenPath = argv[++i];
+		else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			headless.tolerance = std::atof(argv[++i]);
+	}
 
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL) 
-	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+
+	Profiler::Get().SetThreadName("Main");
+	//light binning and draw recording run as jobs, this thread helps while it waits for them
+	JobSystem::Get().Start();
+
+	GLFWwindow* window = NULL;
+	GLADloadproc glLoader = headless.enabled ? (GLADloadproc)HeadlessGetProcAddress : (GLADloadproc)glfwGetProcAddress;
+	if (headless.enabled) {
+		if (!CreateHeadlessContext(3, 3))
+		{
+			std::cout << "Failed to create headless GL context" << std::endl;
+			return -1;
+		}
+
+		if (!gladLoadGLLoader(glLoader))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+		}
 	}
+	else {
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
 
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-	//capture mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL) 
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+		//capture mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+		if (!gladLoadGLLoader(glLoader))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+
+		}
 	}
 
 	// Init ImGui context
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
+	//the window layout in imgui.ini is the user's, headless runs leave it alone
+	if (headless.enabled)
+		io.IniFilename = nullptr;
 	ImGui::StyleColorsDark();
 
-	// Init GLFW + OpenGL3 bindings
-	ImGui_ImplGlfw_InitForOpenGL(window, true);
+	// Init GLFW + OpenGL3 bindings, headless runs feed ImGui its display size directly
+	if (!headless.enabled)
+		ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init("#version 330");
 	io.FontGlobalScale = 1.5f;
 
+	//every bind and state change in the renderer goes through the shadow state, redundant ones are dropped
+	GLState& glState = GLState::Get();
+
+	//draws are collected (big loops on worker threads), sorted by state and depth and issued per layer
+	RenderQueue renderQueue;
+	InstanceData modelInstance;
+
 	//depth testing
-	glEnable(GL_DEPTH_TEST);
+	glState.Enable(GL_DEPTH_TEST);
+
+	//per pass GPU timings for the Performance window
+	GpuProfiler::Get().Init();
+
+	//headless frames go to an FBO the size of the window they replace
+	OffscreenTarget offscreen;
+	if (headless.enabled) {
+		if (!offscreen.Init(SCR_WIDTH, SCR_HEIGHT)) {
+			std::cout << "Failed to create offscreen framebuffer" << std::endl;
+			return -1;
+		}
+		offscreen.Bind();
+		std::cout << "Headless: " << glGetString(GL_RENDERER) << ", " << headless.frames << " frames" << std::endl;
+	}
+
+	//linked programs are cached on disk per source and driver, headless only with --program-cache
+	//variants compiling in the driver fill in with a ready one, the lit ones only need the same vertex layout
+	ProgramCache& programCache = ProgramCache::Get();
+	programCache.Init(glLoader, programCachePath ? programCachePath : headless.enabled ? "" : "shader_cache");
+	auto shaderStart = std::chrono::steady_clock::now();
 
 	//compile shader program
-	Shader cubeShader("shaders/vertex.glsl", "shaders/fragmentLight.glsl");
 	Shader lightSourceShader("shaders/vertex.glsl", "shaders/lightSourceFragmentShader.glsl");
+	Shader lightSourceInstancedShader("shaders/vertex.glsl", "shaders/lightSourceFragmentShader.glsl", "#define INSTANCED\n");
 	Shader debugShader("shaders/debug/lineVertex.glsl", "shaders/debug/lineFragment.glsl");
-
-	//triangle stuff
-
-	float vertices[] = {
-		// positions          // normals           // texture coords
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-	};
+	//deferred path: the cube vertex shader writing the G-buffer, then one screen triangle lights it
+	//normals and light directions grown out of the mesh vertices by a geometry shader
+	Shader debugVectorShader("shaders/debug/vectorVertex.glsl", "shaders/debug/lineFragment.glsl", "shaders/debug/vectorGeometry.glsl", "");
+	Shader debugVectorInstancedShader("shaders/debug/vectorVertex.glsl", "shaders/debug/lineFragment.glsl", "shaders/debug/vectorGeometry.glsl", "#define INSTANCED\n");
 
 	glm::vec3 cubePositions[] = {
 	glm::vec3(0.0f,  0.0f,  0.0f),
@@ -220,121 +561,131 @@ int main() {
 	glm::vec3(0.0f,  0.0f, -3.0f)
 	};
 
-	//separate vertices and normals
-	for (size_t i = 0; i < sizeof(vertices) / sizeof(float); i += 8) {
-		glm::vec3 pos(vertices[i], vertices[i + 1], vertices[i + 2]);
-		glm::vec3 norm(vertices[i + 3], vertices[i + 4], vertices[i + 5]);
-
-		positions.push_back(pos);
-		normals.push_back(norm);
-	}
+	//indexed cube, 24 unique vertices instead of 36
+	Mesh cubeMesh;
+	cubeMesh.Upload(BuildCubeMesh(true));
 
-	unsigned int cubeVAO, VBO;
+	unsigned int cubeVAO;
 	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &VBO);
-
-
-	glBindVertexArray(cubeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	//pos attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3* sizeof(float)));
-	glEnableVertexAttribArray(1);
-	//texture attributte
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
+	glState.BindVertexArray(cubeVAO);
+	cubeMesh.AttachToBoundVAO();
 
 	unsigned int lightVAO;
 	glGenVertexArrays(1, &lightVAO);
-	glBindVertexArray(lightVAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	//DEBUG VAO & VBO
-
-	glGenVertexArrays(1, &debugVAO);
-	glGenBuffers(2, debugVBO);
-
-	// Position buffer
-	glBindVertexArray(debugVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[0]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// Color buffer
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[1]);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	glEnableVertexAttribArray(1);
-
-	glBindVertexArray(0);
-	//--
+	glState.BindVertexArray(lightVAO);
+	cubeMesh.AttachToBoundVAO(true);
+
+	//instanced VAOs, same mesh plus per instance attributes
+	cubeInstances.Init();
+	lightInstances.Init();
+
+	unsigned int cubeInstancedVAO, lightInstancedVAO;
+	glGenVertexArrays(1, &cubeInstancedVAO);
+	glState.BindVertexArray(cubeInstancedVAO);
+	cubeMesh.AttachToBoundVAO();
+	cubeInstances.AttachToBoundVAO();
+
+	glGenVertexArrays(1, &lightInstancedVAO);
+	glState.BindVertexArray(lightInstancedVAO);
+	cubeMesh.AttachToBoundVAO(true);
+	lightInstances.AttachToBoundVAO();
+
+	//optional OBJ model from the command line, drawn with the plain cube shader
+	Model model;
+	bool hasModel = modelPath != nullptr && model.Load(modelPath);
+	const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.5f, -5.0f));
+	if (hasModel)
+		std::cout << "Loaded " << modelPath << (model.LoadedFromCache ? " from cache" : " from OBJ") << std::endl;
+
+	//textures decode on worker threads, until then they show a placeholder
+	//headless skips the .ctex cache so golden images don't depend on what a previous run cooked
+	TextureManager textures;
+	textures.Init(0, true, !headless.enabled);
+
+	unsigned int diffuseMap = textures.Load("container2.png");
+	unsigned int specularMap = textures.Load("container2_specular.png");
 
-	unsigned int diffuseMap, specularMap;
-
-	//Texture1
-	glGenTextures(1, &diffuseMap);
-	glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);	
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load("container2.png", &width, &height, &nrChannels, 0);
-
-	if (!data)
-	{
-		std::cout << "Failed to load texture" << std::endl;
+	//Shader program instancing
+	//the lit shaders are compiled per feature set on first use, a frame picks its variants from ActiveShaderFeatures
+	auto setupLighting = [](Shader& shader) {
+		shader.bindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING);
+		shader.use();
+		//id setters, variants without POINT_LIGHTS have none of these
+		shader.setInt(UniformName("pointLightData"), POINT_LIGHT_UNIT);
+		shader.setInt(UniformName("clusterGrid"), CLUSTER_GRID_UNIT);
+		shader.setInt(UniformName("clusterLightIndices"), CLUSTER_INDEX_UNIT);
+	};
+	const uint32_t allFeatures = (1u << shaderFeatureNames.size()) - 1;
+	ShaderVariants cubeShaders("shaders/vertex.glsl", "shaders/fragmentLight.glsl", shaderFeatureNames, allFeatures,
+		LightClusters::ShaderDefines(), setupLighting);
+	ShaderVariants gbufferShaders("shaders/vertex.glsl", "shaders/deferred/gbufferFragment.glsl", shaderFeatureNames,
+		FEATURE_INSTANCED | FEATURE_SPECULAR_MAP);
+	ShaderVariants deferredLightingShaders("shaders/deferred/screenVertex.glsl", "shaders/deferred/lightingFragment.glsl", shaderFeatureNames,
+		allFeatures & ~FEATURE_INSTANCED, LightClusters::ShaderDefines(), [&setupLighting](Shader& shader) {
+			setupLighting(shader);
+			shader.setInt("gAlbedoSpecular", GBUFFER_UNIT);
+			shader.setInt("gNormal", GBUFFER_UNIT + 1);
+			shader.setInt("gDepth", GBUFFER_UNIT + 2);
+		});
+	cubeShaders.FallbackMatch = FEATURE_INSTANCED;
+	gbufferShaders.FallbackMatch = FEATURE_INSTANCED;
+	deferredLightingShaders.FallbackMatch = 0;
+	double shaderStartupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+
+	//the screen triangle is generated from gl_VertexID, core profile still wants a VAO bound
+	unsigned int screenVAO;
+	glGenVertexArrays(1, &screenVAO);
+
+	//light block, filled once here and then only patched by the light editor
+	lightBlock.Init();
+
+	DirLightStd140 dirLight = {};
+	dirLight.direction = glm::vec3(-0.2f, -0.2f, -0.2f);
+	dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	dirLight.diffuse = glm::vec3(0.1f, 0.1f, 0.1f);
+	dirLight.specular = glm::vec3(0.2f, 0.2f, 0.2f);
+	lightBlock.SetDirLight(dirLight);
+
+	if (startupLights > 0) {
+		ScatterLights(startupLights);
+		animateLights = true;
 	}
+	lightBlock.SetPointLightCount((int)pointLights.size());
+	for (size_t i = 0; i < pointLights.size(); i++)
+		lightBlock.SetPointLight((int)i, PackPointLight(pointLights[i]));
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	stbi_image_free(data);
+	lightClusters.Init();
 
-	//Texture2
-	glGenTextures(1, &specularMap);
-	glBindTexture(GL_TEXTURE_2D, specularMap);
+	//what the first frame asks for, building side by side instead of one after the other
+	const uint32_t startupFeatures = ActiveShaderFeatures();
+	ShaderVariants& startupShaders = debug.renderPath == PATH_DEFERRED ? gbufferShaders : cubeShaders;
+	startupShaders.Prepare(startupFeatures);
+	startupShaders.Prepare(startupFeatures | FEATURE_INSTANCED);
+	if (debug.renderPath == PATH_DEFERRED)
+		deferredLightingShaders.Prepare(startupFeatures);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+	InitDebugLines(glLoader);
+	FrameStats shownStats;
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//headless frames must be reproducible, so start with every texture in place
+	std::vector<HeadlessFrame> headlessFrames;
+	int frameIndex = 0;
+	if (headless.enabled)
+		textures.FinishPending();
 
-	stbi_set_flip_vertically_on_load(true);
-	data = stbi_load("container2_specular.png", &width, &height, &nrChannels, 0);
-
-	if (!data)
+	//Render loop
+	while (headless.enabled ? frameIndex < headless.frames : !glfwWindowShouldClose(window))
 	{
-		std::cout << "Failed to load texture" << std::endl;
-	}
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
+		frameStats = FrameStats();
+		Profiler::Get().BeginFrame();
+		GpuProfiler::Get().BeginFrame();
+		GpuScope frameGpuScope("Frame");
 
-	stbi_image_free(data);
+		//finished texture decodes, capped so a burst of loads can't cause a hitch
+		frameStats.bytesUploaded += textures.ProcessUploads(2.0);
 
-	//Shader program instancing
-	cubeShader.use();
-	cubeShader.setInt("material.diffuse", 0);
-
-	InitDebugLines();
-	//Render loop
-	while (!glfwWindowShouldClose(window))
-	{
-		//delta time calculation
-		float currentFrame = glfwGetTime();
+		//delta time calculation, headless runs step a fixed 60 Hz
+		float currentFrame = headless.enabled ? frameIndex / 60.0f : (float)glfwGetTime();
 
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
@@ -344,11 +695,19 @@ int main() {
 		}
 
 		//input
-		processInput(window);
+		if (!headless.enabled)
+			processInput(window);
 
 		//Start imGui frame
+		ProfileScope imguiBuildScope("ImGui build");
 		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
+		if (headless.enabled) {
+			io.DisplaySize = ImVec2((float)SCR_WIDTH, (float)SCR_HEIGHT);
+			io.DeltaTime = 1.0f / 60.0f;
+		}
+		else {
+			ImGui_ImplGlfw_NewFrame();
+		}
 		ImGui::NewFrame();
 
 		//-------------------------------------------------------------------IMGUI------------------------------------------------------------
@@ -385,17 +744,73 @@ int main() {
 		ImGui::Checkbox("Pause Time", &timePaused);
 		ImGui::SliderFloat("Time Scale", &timeScale, 0.0f, 3.0f);
 
+		ImGui::Separator();
+		ImGui::TextColored(ImVec4(1, 1, 0, 1), "Rendering");
+		ImGui::Separator();
+
+		ImGui::Checkbox("Instanced Rendering", &debug.instancedRendering);
+		ImGui::Combo("Frustum Culling", &debug.cullMode, cullModeNames, IM_ARRAYSIZE(cullModeNames));
+		ImGui::Checkbox("Light Cluster Heatmap", &debug.clusterHeatmap);
+		ImGui::SameLine();
+		ImGui::Checkbox("Specular Maps", &debug.specularMaps);
+		ImGui::Combo("Shading", &debug.renderPath, renderPathNames, IM_ARRAYSIZE(renderPathNames));
+
+		if (!pick.hit)
+			ImGui::Text("Picked: nothing (Tab, then click an object)");
+		else if (pick.object & LIGHT_PROXY_BIT)
+			ImGui::Text("Picked: light %u, %.2f away", (pick.object & ~LIGHT_PROXY_BIT) + 1, pick.distance);
+		else
+			ImGui::Text("Picked: cube %u, %.2f away", pick.object, pick.distance);
+		ImGui::SliderInt("Cube Count", &debug.cubeCount, 1, 100000, "%d", ImGuiSliderFlags_Logarithmic);
+
 
 		ImGui::End();
 
+		//room for the timeline the first time, after that the saved layout wins
+		ImGui::SetNextWindowPos(ImVec2(1000.0f, 2.0f), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(598.0f, 520.0f), ImGuiCond_FirstUseEver);
 		ImGui::Begin("Performance");
 		ImGui::Text("FPS: %.1f (%.3f ms/frame)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+		//counters of the previous frame, this one is still being built
+		ImGui::Text("Draw calls: %d", shownStats.drawCalls);
+		ImGui::Text("Uploaded: %.2f KB", shownStats.bytesUploaded / 1024.0f);
+		ImGui::Text("Objects: %d visible, %d culled", shownStats.objectsVisible, shownStats.objectsCulled);
+		ImGui::Text("Transforms: %zu nodes, %d updated", sceneTransforms.Size(), shownStats.transformsUpdated);
+		ImGui::Text("GL state calls: %d issued, %d elided", shownStats.glCallsIssued, shownStats.glCallsElided);
+		ImGui::Text("Render queue: %d draws in %d chunks, %d program, %d material, %d VAO changes", shownStats.queuedDraws,
+			shownStats.recordChunks, shownStats.programChanges, shownStats.materialChanges, shownStats.vertexArrayChanges);
+		ImGui::Text("Light clusters: %d lights in view, %zu indices, max %d per cluster%s", lightClusters.LightsInView,
+			lightClusters.IndexCount, lightClusters.MaxLightsPerCluster, lightClusters.Overflowed ? " (capped)" : "");
+		if (debug.renderPath == PATH_DEFERRED)
+			ImGui::Text("G-buffer: %d x %d, %.1f MB", gBuffer.Width, gBuffer.Height, gBuffer.MemoryBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Shader variants: %zu compiled, %.1f ms, %zu pending, %d fallback draws", cubeShaders.CompiledCount + gbufferShaders.CompiledCount + deferredLightingShaders.CompiledCount,
+			cubeShaders.CompileMilliseconds + gbufferShaders.CompileMilliseconds + deferredLightingShaders.CompileMilliseconds,
+			cubeShaders.PendingCount() + gbufferShaders.PendingCount() + deferredLightingShaders.PendingCount(),
+			cubeShaders.FallbackUses + gbufferShaders.FallbackUses + deferredLightingShaders.FallbackUses);
+		ImGui::Text("Program cache: %d hits, %d misses, %d rejected%s, fixed shaders %.1f ms", programCache.Hits, programCache.Misses, programCache.Rejected,
+			programCache.BinariesEnabled() ? "" : " (off)", shaderStartupMs);
+		ImGui::Text("Textures pending: %d", textures.PendingCount());
+		ImGui::Text("Texture memory: %.1f KB", textures.TextureMemory() / 1024.0f);
+		ImGui::Text("Debug lines: %s ring, %zu verts/frame, %d stalls", debugDraw.Persistent() ? "persistent" : "3.3", debugDraw.Capacity(), debugDraw.Stalls);
+		RenderProfilerTimeline();
 		ImGui::End();
 
-		glPolygonMode(GL_FRONT_AND_BACK, debug.showWireframe == true ? GL_LINE : GL_FILL);
+		glState.PolygonMode(GL_FRONT_AND_BACK, debug.showWireframe || wireframeKeyHeld ? GL_LINE : GL_FILL);
 
 		RenderLightEditor();
-		SetLightsToShader(cubeShader);
+		imguiBuildScope.End();
+
+		if (animateLights)
+			AnimateLights();
+
+		//deferred draws the same geometry with the G-buffer shaders and lights it afterwards
+		//either way the variants only carry the lights and maps that are active this frame
+		bool deferred = debug.renderPath == PATH_DEFERRED;
+		uint32_t features = ActiveShaderFeatures();
+		ShaderVariants& objectShaders = deferred ? gbufferShaders : cubeShaders;
+		Shader& objectShader = objectShaders.Get(features);
+		Shader& sceneShader = debug.instancedRendering ? objectShaders.Get(features | FEATURE_INSTANCED) : objectShader;
+		SetLightsToShader(sceneShader);
 
 		//-------------------------------------------------------------------IMGUI------------------------------------------------------------
 
@@ -406,7 +821,7 @@ int main() {
 		//bind textures
 
 		//make cube matrix 
-		cubeShader.use();
+		sceneShader.use();
 		////dir light
 		//cubeShader.setVec3("dirLight.direction",-0.2, -0.2, -0.2);
 		//cubeShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
@@ -440,19 +855,13 @@ int main() {
 		////cubeShader.setVec3("spotLight.specular", 0.3f, 0.3f, 0.3f);
 
 		//extra
-		cubeShader.setVec3("viewPos", camera.Position);
+		sceneShader.setVec3(U_VIEW_POS, camera.Position);
 
 
 		//material uniforms
-		cubeShader.setInt("material.diffuse", 0);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-		cubeShader.setInt("material.specular", 1);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specularMap);
+		//the maps themselves are bound per packet by the render queue
+		sceneShader.setInt(U_MATERIAL_DIFFUSE, 0);
+		sceneShader.setInt(U_MATERIAL_SPECULAR, 1);
 
 		//--------------------------------------------------------------------------------------------------------
 		//static glm::vec3 lightAmbient = glm::vec3(0.1f);
@@ -485,114 +894,383 @@ int main() {
 
 		//--------------------------------------------------------------------------------------------------------------------
 
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
 		glm::mat4 view = camera.GetViewMatrix();
 
-		cubeShader.setMat4("projection", projection);
-		cubeShader.setMat4("view", view);
+		sceneShader.setMat4(U_PROJECTION, projection);
+		sceneShader.setMat4(U_VIEW, view);
 
-		for (unsigned int i = 0; i < 10; i++)
+		bool cubesRebuilt = false;
+		if ((int)cubeNodeCount != debug.cubeCount) {
+			//the light nodes after the cubes are added back by SyncLightTransforms
+			sceneTransforms.Clear();
+			AddCubeTransforms(sceneTransforms, debug.cubeCount, cubePositions, 10);
+			cubeNodeCount = (uint32_t)sceneTransforms.Size();
+			cubesRebuilt = true;
+		}
+		SyncLightTransforms();
 		{
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
-
-			cubeShader.setMat4("model", model);
+			PROFILE_SCOPE("Transform update");
+			//only what moved since the last frame (usually the animated lights) is recomputed
+			frameStats.transformsUpdated = (int)sceneTransforms.Update();
+			if (frameStats.transformsUpdated > 0)
+				lightInstancesDirty = true;
+		}
+		if (cubesRebuilt) {
+			//static scene, instances and bounds are only rebuilt when the cube count changes
+			BuildCubeInstances(sceneTransforms.World(), cubeNodeCount, cubeInstanceData);
+			BuildCubeBounds(sceneTransforms.World(), cubeNodeCount, cubeBounds);
+			BuildSceneTree(sceneTransforms.World(), cubeNodeCount);
+			cubeInstancesDirty = true;
+		}
+		SyncLightProxies();
 
-			glBindVertexArray(cubeVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		{
+			PROFILE_SCOPE("Frustum culling");
+			Frustum frustum = camera.GetFrustum(projection);
+			if (debug.cullMode == CULL_TREE) {
+				CullSceneTree(frustum);
+			}
+			else {
+				CullObjects(frustum, cubeBounds, visibleCubes);
+
+				lightBounds.Clear();
+				lightBoundOwners.clear();
+				for (size_t i = 0; i < pointLights.size(); i++) {
+					if (!pointLights[i].enabled) continue;
+					lightBounds.Add(pointLights[i].position, CUBE_BOUNDING_RADIUS * 0.2f);
+					lightBoundOwners.push_back((uint32_t)i);
+				}
+				CullObjects(frustum, lightBounds, visibleLights);
+				for (uint32_t& light : visibleLights)
+					light = lightBoundOwners[light];
+			}
 		}
 
-		glm::mat4 model = glm::mat4(1.0f);
+		if (pick.pending) {
+			PROFILE_SCOPE("Picking");
+			PickObject(pick.cursor, projection, view);
+			pick.pending = false;
+		}
+		if (pick.hit && !(pick.object & LIGHT_PROXY_BIT) && pick.object < cubeNodeCount)
+			AddDebugBox(TransformedUnitCube(sceneTransforms.World(pick.object)), glm::vec3(1.0f, 1.0f, 0.0f));
+
+		UpdateLightClusters(view, projection);
+
+		GLint sceneFramebuffer = 0;
+		if (deferred) {
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &sceneFramebuffer);
+			if (!gBuffer.Resize(framebufferSize.x, framebufferSize.y))
+				std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+			gBuffer.Bind();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		else {
+			SetLightingUniforms(sceneShader);
+		}
 
-		//make light source cube
-		lightSourceShader.use();
-		lightSourceShader.setMat4("projection", projection);
-		lightSourceShader.setMat4("view", view);
+		if (cubeInstancesDirty || visibleCubes != uploadedCubes) {
+			PROFILE_SCOPE("Cube instance upload");
+			std::vector<InstanceData> instances(visibleCubes.size());
+			for (size_t i = 0; i < visibleCubes.size(); i++)
+				instances[i] = cubeInstanceData[visibleCubes[i]];
+			frameStats.bytesUploaded += cubeInstances.Upload(instances);
+			uploadedCubes = visibleCubes;
+			cubeInstancesDirty = false;
+		}
 
-		for (int i = 0; i < POINT_LIGHT_AMOUNT; i++)
+		//everything drawn this frame as packets, sorted once; the deferred lighting pass goes between the scene and the unlit layers
+		renderQueue.Clear();
+		renderQueue.SetView(view, CAMERA_NEAR, CAMERA_FAR);
 		{
-			if (!pointLights[i].enabled) continue;
+			PROFILE_SCOPE("Render queue");
+			DrawPacket cube;
+			cube.textures[0] = diffuseMap;
+			cube.textures[1] = specularMap;
+			cube.count = cubeMesh.IndexCount;
+			cube.indexType = cubeMesh.IndexType;
+			if (debug.instancedRendering) {
+				if (cubeInstances.Count() > 0) {
+					cube.shader = &sceneShader;
+					cube.vertexArray = cubeInstancedVAO;
+					cube.instanceCount = (GLsizei)cubeInstances.Count();
+					renderQueue.Submit(cube, RENDER_LAYER_SCENE, 0.0f);
+				}
+			}
+			else {
+				cube.shader = &objectShader;
+				cube.vertexArray = cubeVAO;
+				renderQueue.Record(visibleCubes.size(), [&](RenderQueue::Recorder& recorder, size_t begin, size_t end) {
+					DrawPacket packet = cube;
+					for (size_t k = begin; k < end; k++) {
+						const InstanceData& instance = cubeInstanceData[visibleCubes[k]];
+						packet.instance = &instance;
+						recorder.Submit(packet, RENDER_LAYER_SCENE, recorder.ViewDepth(glm::vec3(instance.model[3])));
+					}
+				});
+			}
 
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, pointLights[i].position);
-			model = glm::scale(model, glm::vec3(0.2));
-			//model = glm::rotate(glm::mat4(1.0f), engineTime, glm::vec3(0.0f, 1.0f, 0.0f)) * model;
+			if (hasModel) {
+				modelInstance.model = modelMatrix;
+				modelInstance.normalMatrix = NormalMatrix(modelMatrix);
+				modelInstance.color = glm::vec3(1.0f);
+
+				DrawPacket packet;
+				packet.shader = &objectShader;
+				packet.vertexArray = model.VAO;
+				packet.textures[0] = diffuseMap;
+				packet.textures[1] = specularMap;
+				packet.count = model.mesh.IndexCount;
+				packet.indexType = model.mesh.IndexType;
+				packet.instance = &modelInstance;
+				renderQueue.Submit(packet, RENDER_LAYER_SCENE, renderQueue.ViewDepth(glm::vec3(modelMatrix[3])));
+			}
 
-			lightSourceShader.setMat4("model", model);
-			lightSourceShader.setVec3("DiffuseColor", pointLights[i].diffuse);
+			//light source cubes
+			DrawPacket light;
+			light.count = cubeMesh.IndexCount;
+			light.indexType = cubeMesh.IndexType;
+			if (debug.instancedRendering) {
+				if (lightInstancesDirty || visibleLights != uploadedLights) {
+					std::vector<InstanceData> instances;
+					BuildLightInstances(visibleLights, instances);
+					frameStats.bytesUploaded += lightInstances.Upload(instances);
+					uploadedLights = visibleLights;
+					lightInstancesDirty = false;
+				}
+
+				if (lightInstances.Count() > 0) {
+					light.shader = &lightSourceInstancedShader;
+					light.vertexArray = lightInstancedVAO;
+					light.instanceCount = (GLsizei)lightInstances.Count();
+					renderQueue.Submit(light, RENDER_LAYER_LIGHT_SOURCES, 0.0f);
+				}
+			}
+			else {
+				light.shader = &lightSourceShader;
+				light.vertexArray = lightVAO;
+				//the instance data is packed by the recording thread, in its arena
+				renderQueue.Record(visibleLights.size(), [&](RenderQueue::Recorder& recorder, size_t begin, size_t end) {
+					DrawPacket packet = light;
+					for (size_t k = begin; k < end; k++) {
+						const LightSettings& settings = pointLights[visibleLights[k]];
+						InstanceData* instance = recorder.Allocate<InstanceData>();
+						instance->model = sceneTransforms.World(cubeNodeCount + visibleLights[k]);
+						instance->normalMatrix = glm::mat3(1.0f);
+						instance->color = settings.diffuse;
+						packet.instance = instance;
+						recorder.Submit(packet, RENDER_LAYER_LIGHT_SOURCES, recorder.ViewDepth(settings.position));
+					}
+				});
+			}
 
-			//glm::vec4 localLighSource = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-			//lightPos = glm::vec3(model * localLighSource);
+			//one point per vertex straight from the mesh VBOs, the geometry shader expands them to lines
+			if (debug.showNormals || debug.showLightDirs) {
+				DrawPacket vectors;
+				vectors.mode = GL_POINTS;
+				if (cubeInstances.Count() > 0) {
+					vectors.shader = &debugVectorInstancedShader;
+					vectors.vertexArray = cubeInstancedVAO;
+					vectors.count = cubeMesh.VertexCount;
+					vectors.instanceCount = (GLsizei)cubeInstances.Count();
+					renderQueue.Submit(vectors, RENDER_LAYER_DEBUG, 0.0f);
+				}
+				if (hasModel) {
+					vectors.shader = &debugVectorShader;
+					vectors.vertexArray = model.VAO;
+					vectors.count = model.mesh.VertexCount;
+					vectors.instanceCount = 0;
+					vectors.instance = &modelInstance;
+					renderQueue.Submit(vectors, RENDER_LAYER_DEBUG, renderQueue.ViewDepth(glm::vec3(modelMatrix[3])));
+				}
+			}
 
-			glBindVertexArray(lightVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			renderQueue.Sort();
 		}
 
-		const int vertexCount = 36; // 12 triangles * 3 verts
-		auto positions = ExtractPositions(vertices, vertexCount);
-		auto normals = ExtractNormals(vertices, vertexCount);
-		
-		if (debug.showLightDirs) {
-			glm::vec3 Ldirection = glm::normalize(glm::vec3(-0.2f)); // or whatever
-
-			for (unsigned int i = 0; i < 10; i++) {
-				glm::mat4 model = glm::mat4(1.0f);
-				model = glm::translate(model, cubePositions[i]);
-				float angle = 20.0f * i;
-				model = glm::rotate(model, glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
-
-				ShowLightFromSurface(Ldirection, positions, normals, model);
+		{
+			PROFILE_SCOPE("Scene");
+			GPU_PROFILE_SCOPE("Scene");
+			//the model always uses the non instanced variant, which only got this frame's uniforms if it is the scene shader
+			if (hasModel && &objectShader != &sceneShader) {
+				objectShader.use();
+				objectShader.setMat4(U_PROJECTION, projection);
+				objectShader.setMat4(U_VIEW, view);
+				objectShader.setVec3(U_VIEW_POS, camera.Position);
+				objectShader.setInt(U_MATERIAL_DIFFUSE, 0);
+				objectShader.setInt(U_MATERIAL_SPECULAR, 1);
+				if (!deferred)
+					SetLightingUniforms(objectShader);
 			}
+			renderQueue.Execute(RENDER_LAYER_SCENE);
+		}
 
-			RenderDebugLines(debugShader, view, projection);
+		if (deferred) {
+			PROFILE_SCOPE("Deferred lighting");
+			GPU_PROFILE_SCOPE("Lighting");
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+
+			Shader& deferredLightingShader = deferredLightingShaders.Get(features);
+			deferredLightingShader.use();
+			deferredLightingShader.setMat4(U_INVERSE_VIEW_PROJECTION, glm::inverse(projection * view));
+			deferredLightingShader.setVec3(U_VIEW_POS, camera.Position);
+			SetLightingUniforms(deferredLightingShader);
+			gBuffer.BindTextures(GL_TEXTURE0 + GBUFFER_UNIT);
+			glState.ActiveTexture(GL_TEXTURE0);
+
+			//every covered pixel once, whatever the overdraw was; the G-buffer depth is written through
+			//(depth test always passes) so the light cubes and debug lines below still sort against the scene
+			glState.PolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glState.DepthFunc(GL_ALWAYS);
+			glState.BindVertexArray(screenVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			frameStats.drawCalls++;
+			glState.DepthFunc(GL_LESS);
+			glState.PolygonMode(GL_FRONT_AND_BACK, debug.showWireframe || wireframeKeyHeld ? GL_LINE : GL_FILL);
 		}
 
-		if (debug.showNormals) {
-			for (unsigned int i = 0; i < 10; i++) {
-				glm::mat4 model = glm::mat4(1.0f);
-				model = glm::translate(model, cubePositions[i]);
-				float angle = 20.0f * i;
-				model = glm::rotate(model, glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
+		{
+			GPU_PROFILE_SCOPE("Light cubes");
+			Shader& lightShader = debug.instancedRendering ? lightSourceInstancedShader : lightSourceShader;
+			lightShader.use();
+			lightShader.setMat4(U_PROJECTION, projection);
+			lightShader.setMat4(U_VIEW, view);
+			renderQueue.Execute(RENDER_LAYER_LIGHT_SOURCES);
+		}
 
-				ShowNormals(positions, normals, model);
+		if (debug.showNormals || debug.showLightDirs) {
+			PROFILE_SCOPE("Debug vectors");
+			GPU_PROFILE_SCOPE("Debug vectors");
+			Shader* vectorShaders[] = { &debugVectorInstancedShader, &debugVectorShader };
+			for (Shader* shader : vectorShaders) {
+				shader->use();
+				shader->setMat4(U_PROJECTION, projection);
+				shader->setMat4(U_VIEW, view);
+				shader->setBool(U_SHOW_NORMALS, debug.showNormals);
+				shader->setBool(U_SHOW_LIGHT_DIRS, debug.showLightDirs);
+				shader->setVec3(U_LIGHT_DIRECTION, dirLight.direction);
 			}
-
-			RenderDebugLines(debugShader, view, projection);
+			renderQueue.Execute(RENDER_LAYER_DEBUG);
+			glState.BindVertexArray(0);
 		}
 
+		frameStats.drawCalls += renderQueue.DrawCalls;
+		frameStats.bytesUploaded += renderQueue.UniformBytes;
+		frameStats.queuedDraws = (int)renderQueue.Count();
+		frameStats.recordChunks = renderQueue.RecordChunks;
+		frameStats.programChanges = renderQueue.ProgramChanges;
+		frameStats.materialChanges = renderQueue.MaterialChanges;
+		frameStats.vertexArrayChanges = renderQueue.VertexArrayChanges;
+
+		//lines queued with AddDebugLine this frame
+		RenderDebugLines(debugShader, view, projection);
+
 
 		//kebab con carne, pollo y salsa picante 🥙
 
 		//glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-		// Render ImGui
+		// Render ImGui, headless images are the scene only (the UI shows timings, which never match)
+		ProfileScope imguiRenderScope("ImGui render");
+		GpuScope imguiGpuScope("ImGui");
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.enabled)
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		imguiGpuScope.End();
+		imguiRenderScope.End();
+
+		ProfileScope swapScope("Swap buffers");
+		if (headless.enabled) {
+			glFlush();
+		}
+		else {
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		swapScope.End();
+		frameGpuScope.End();
+
+		debugDraw.EndFrame();
+		frameStats.glCallsIssued = glState.Issued;
+		frameStats.glCallsElided = glState.Elided;
+		glState.ResetCounters();
+		shownStats = frameStats;
+		Profiler::Get().EndFrame();
+
+		if (headless.enabled) {
+			Profiler& profiler = Profiler::Get();
+			GpuProfiler& gpuProfiler = GpuProfiler::Get();
+			HeadlessFrame frame;
+			frame.cpuMilliseconds = (profiler.LastFrameEnd - profiler.LastFrameStart) / 1e6;
+			frame.gpuMilliseconds = gpuProfiler.LastResults.empty() ? 0.0 : gpuProfiler.LastFrameMilliseconds;
+			frame.cpuScopes = profiler.LastFrameTotals;
+			frame.gpuPasses = gpuProfiler.LastResults;
+			frame.glCallsIssued = frameStats.glCallsIssued;
+			frame.glCallsElided = frameStats.glCallsElided;
+			frame.drawCalls = frameStats.drawCalls;
+			frame.bytesUploaded = frameStats.bytesUploaded;
+			headlessFrames.push_back(frame);
+		}
+		frameIndex++;
+	}
+
+	int exitCode = 0;
+	if (headless.enabled) {
+		glFinish();
+
+		std::vector<unsigned char> pixels;
+		offscreen.ReadPixels(pixels);
+		if (!headless.dumpPath.empty() && !WritePPM(headless.dumpPath, pixels.data(), offscreen.Width, offscreen.Height)) {
+			std::cout << "Failed to write " << headless.dumpPath << std::endl;
+			exitCode = -1;
+		}
 
+		ImageDiff diff;
+		bool compared = !headless.goldenPath.empty();
+		if (compared && CompareWithGolden(pixels, offscreen.Width, offscreen.Height, diff) != 0)
+			exitCode = 1;
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		if (!WriteHeadlessReport(headless.reportPath, headlessFrames, compared ? &diff : nullptr)) {
+			std::cout << "Failed to write " << headless.reportPath << std::endl;
+			exitCode = -1;
+		}
+		offscreen.Destroy();
 	}
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteVertexArrays(1, &lightVAO);
-	glDeleteBuffers(1, &VBO);
+	glState.DeleteVertexArrays(1, &cubeVAO);
+	glState.DeleteVertexArrays(1, &lightVAO);
+	glState.DeleteVertexArrays(1, &cubeInstancedVAO);
+	glState.DeleteVertexArrays(1, &lightInstancedVAO);
+	glState.DeleteVertexArrays(1, &screenVAO);
+	gBuffer.Destroy();
+	cubeInstances.Destroy();
+	lightInstances.Destroy();
+	cubeMesh.Destroy();
+	model.Destroy();
+	debugDraw.Destroy();
+	GpuProfiler::Get().Destroy();
+	textures.Destroy();
+	lightBlock.Destroy();
+	lightClusters.Destroy();
+	JobSystem::Get().Shutdown();
 
 	//close imGui
 	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
+	if (!headless.enabled)
+		ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
-	glfwTerminate();
+	if (headless.enabled)
+		DestroyHeadlessContext();
+	else
+		glfwTerminate();
 
-	return 0;
+	return exitCode;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	framebufferSize = glm::ivec2(width, height);
 }
 
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset)
@@ -623,10 +1301,11 @@ void mouse_callback(GLFWwindow* window, double xPosIn, double yPosIn)
 
 void processInput(GLFWwindow* window)
 {
+	PROFILE_SCOPE("processInput");
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
-	glPolygonMode(GL_FRONT_AND_BACK, glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS ? GL_LINE : GL_FILL);
+	wireframeKeyHeld = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
 
 	//toggle mouse
 	if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS)
@@ -648,6 +1327,20 @@ void processInput(GLFWwindow* window)
 		tabPressedLastFrame = false;
 	}
 
+	//click to pick, ignored when ImGui has the mouse
+	bool clickPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+	if (clickPressed && !clickPressedLastFrame && cursorVisible && !ImGui::GetIO().WantCaptureMouse) {
+		double x, y;
+		int width, height;
+		glfwGetCursorPos(window, &x, &y);
+		glfwGetWindowSize(window, &width, &height);
+		if (width > 0 && height > 0) {
+			pick.cursor = glm::vec2((float)(x / width), 1.0f - (float)(y / height));
+			pick.pending = true;
+		}
+	}
+	clickPressedLastFrame = clickPressed;
+
 	//Camera controls
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera.ProcessKeyboard(FOWARD, deltaTime);
@@ -662,155 +1355,1369 @@ void processInput(GLFWwindow* window)
 void RenderLightEditor() {
 	ImGui::Begin("Light Controls");
 
-	const char* items[POINT_LIGHT_AMOUNT] = { "Light 1", "Light 2", "Light 3", "Light 4" };
-	ImGui::Combo("Select Light", &selectedLight, items, POINT_LIGHT_AMOUNT);
+	int lightCount = (int)pointLights.size();
+
+	if (ImGui::Button("Add Light") && lightCount < LightBlock::MAX_POINT_LIGHTS) {
+		lightInstancesDirty = true;
+		pointLights.push_back({ camera.Position + camera.Front * 2.0f, glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f) });
+		lightBlock.SetPointLight(lightCount, PackPointLight(pointLights.back()));
+		selectedLight = lightCount++;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Remove Light") && lightCount > 0) {
+		lightInstancesDirty = true;
+		if (selectedLight < (int)lightProxies.size()) {
+			if (lightProxies[selectedLight] != AABBTree::NULL_NODE)
+				sceneTree.DestroyProxy(lightProxies[selectedLight]);
+			lightProxies.erase(lightProxies.begin() + selectedLight);
+		}
+		pointLights.erase(pointLights.begin() + selectedLight);
+		lightCount--;
+		//lights after the removed one shift down a slot
+		for (int i = selectedLight; i < lightCount; i++)
+			lightBlock.SetPointLight(i, PackPointLight(pointLights[i]));
+		if (selectedLight >= lightCount && selectedLight > 0)
+			selectedLight = lightCount - 1;
+	}
+	ImGui::SameLine();
+	ImGui::Text("%d / %d", lightCount, LightBlock::MAX_POINT_LIGHTS);
+
+	//bulk lights for the clustered shading, dim and short ranged so only a few dozen reach any one point
+	static int scatterCount = 1000;
+	ImGui::SliderInt("##scatterCount", &scatterCount, 1, 10000, "%d", ImGuiSliderFlags_Logarithmic);
+	ImGui::SameLine();
+	if (ImGui::Button("Scatter Lights")) {
+		ScatterLights(std::min(scatterCount, LightBlock::MAX_POINT_LIGHTS - lightCount));
+		for (int i = lightCount; i < (int)pointLights.size(); i++)
+			lightBlock.SetPointLight(i, PackPointLight(pointLights[i]));
+		lightCount = (int)pointLights.size();
+		lightInstancesDirty = true;
+	}
+	if (ImGui::Button("Remove Scattered")) {
+		//proxies are recreated by SyncLightProxies for whatever is left
+		for (int proxy : lightProxies)
+			if (proxy != AABBTree::NULL_NODE)
+				sceneTree.DestroyProxy(proxy);
+		lightProxies.clear();
+		pointLights.erase(std::remove_if(pointLights.begin(), pointLights.end(), [](const LightSettings& light) { return light.orbitRadius > 0.0f; }), pointLights.end());
+		lightCount = (int)pointLights.size();
+		for (int i = 0; i < lightCount; i++)
+			lightBlock.SetPointLight(i, PackPointLight(pointLights[i]));
+		selectedLight = std::max(0, std::min(selectedLight, lightCount - 1));
+		lightInstancesDirty = true;
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Animate Lights", &animateLights);
+
+	ImGui::Checkbox("Directional Light", &dirLightEnabled);
+	ImGui::SameLine();
+	ImGui::Checkbox("Flashlight", &flashlight.enabled);
+	if (flashlight.enabled) {
+		ImGui::SliderFloat("Inner Cone", &flashlight.cutOff, 1.0f, 60.0f, "%.1f deg");
+		ImGui::SliderFloat("Outer Cone", &flashlight.outerCutOff, flashlight.cutOff, 75.0f, "%.1f deg");
+	}
+
+	lightBlock.SetPointLightCount(lightCount);
+
+	if (lightCount == 0) {
+		ImGui::End();
+		return;
+	}
+
+	std::string preview = "Light " + std::to_string(selectedLight + 1);
+	if (ImGui::BeginCombo("Select Light", preview.c_str())) {
+		for (int i = 0; i < lightCount; i++) {
+			std::string item = "Light " + std::to_string(i + 1);
+			if (ImGui::Selectable(item.c_str(), i == selectedLight))
+				selectedLight = i;
+		}
+		ImGui::EndCombo();
+	}
 
 	LightSettings& light = pointLights[selectedLight];
 
-	ImGui::Checkbox("Enabled", &light.enabled);
-	ImGui::SliderFloat3("Position", &light.position.x, -10.0f, 10.0f);
-	ImGui::ColorEdit3("Ambient", &light.ambient.x);
-	ImGui::ColorEdit3("Diffuse", &light.diffuse.x);
-	ImGui::ColorEdit3("Specular", &light.specular.x);
-	ImGui::SliderFloat("Constant", &light.constant, 0.0f, 2.0f);
-	ImGui::SliderFloat("Linear", &light.linear, 0.0f, 1.0f);
-	ImGui::SliderFloat("Quadratic", &light.quadratic, 0.0f, 1.0f);
+	bool changed = false;
+	changed |= ImGui::Checkbox("Enabled", &light.enabled);
+	changed |= ImGui::SliderFloat3("Position", &light.position.x, -10.0f, 10.0f);
+	changed |= ImGui::ColorEdit3("Ambient", &light.ambient.x);
+	changed |= ImGui::ColorEdit3("Diffuse", &light.diffuse.x);
+	changed |= ImGui::ColorEdit3("Specular", &light.specular.x);
+	changed |= ImGui::SliderFloat("Constant", &light.constant, 0.0f, 2.0f);
+	changed |= ImGui::SliderFloat("Linear", &light.linear, 0.0f, 1.0f);
+	changed |= ImGui::SliderFloat("Quadratic", &light.quadratic, 0.0f, 1.0f);
+
+	if (changed) {
+		lightBlock.SetPointLight(selectedLight, PackPointLight(light));
+		lightInstancesDirty = true;
+	}
 
 	ImGui::End();
 }
 
+//timeline of the previous frame: one lane per thread, nested scopes stacked below their parent
+void RenderProfilerTimeline() {
+	Profiler& profiler = Profiler::Get();
+	int64_t frameLength = profiler.LastFrameEnd - profiler.LastFrameStart;
+	if (frameLength <= 0) return;
+
+	ImGui::Separator();
+
+	//lanes only for threads that recorded something, each as deep as its deepest scope
+	size_t threadCount = profiler.LastFrameThreadNames.size();
+	std::vector<int> laneDepth(threadCount, 0);
+	for (const ProfileEvent& event : profiler.LastFrameEvents)
+		laneDepth[event.thread] = std::max(laneDepth[event.thread], (int)event.depth + 1);
+
+	const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+	const float labelWidth = ImGui::CalcTextSize("Texture 00").x + 8.0f;
+	std::vector<float> laneY(threadCount, 0.0f);
+	float height = 0.0f;
+	for (size_t t = 0; t < threadCount; t++) {
+		laneY[t] = height;
+		height += laneDepth[t] * rowHeight;
+	}
+	if (height <= 0.0f) return;
+
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float width = std::max(ImGui::GetContentRegionAvail().x, labelWidth + 200.0f);
+	float timelineWidth = width - labelWidth;
+	ImGui::InvisibleButton("##timeline", ImVec2(width, height));
+	bool hovered = ImGui::IsItemHovered();
+	ImVec2 mouse = ImGui::GetIO().MousePos;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(30, 30, 30, 255));
+
+	for (size_t t = 0; t < threadCount; t++) {
+		if (laneDepth[t] == 0) continue;
+		drawList->AddText(ImVec2(origin.x + 2.0f, origin.y + laneY[t] + 2.0f), IM_COL32(200, 200, 200, 255), profiler.LastFrameThreadNames[t].c_str());
+	}
+
+	for (const ProfileEvent& event : profiler.LastFrameEvents) {
+		double start = (double)(event.start - profiler.LastFrameStart) / frameLength;
+		double end = (double)(event.end - profiler.LastFrameStart) / frameLength;
+		float x0 = origin.x + labelWidth + (float)std::max(0.0, start) * timelineWidth;
+		float x1 = origin.x + labelWidth + (float)std::min(1.0, end) * timelineWidth;
+		x1 = std::max(x1, x0 + 1.0f);
+		float y0 = origin.y + laneY[event.thread] + event.depth * rowHeight;
+		float y1 = y0 + rowHeight - 1.0f;
+
+		//stable colour per scope name
+		unsigned int hash = HashUniformName(event.name);
+		ImU32 color = ImColor::HSV((hash % 360) / 360.0f, 0.55f, 0.75f);
+		drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), color);
+
+		ImVec2 textSize = ImGui::CalcTextSize(event.name);
+		if (textSize.x + 4.0f < x1 - x0)
+			drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+
+		if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+			ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1e6);
+	}
+
+	//CPU scope totals beside the GPU passes (those are a few frames older, see GpuProfiler)
+	GpuProfiler& gpuProfiler = GpuProfiler::Get();
+	if (ImGui::BeginTable("##scopeTimes", 2, ImGuiTableFlags_BordersInnerV)) {
+		ImGui::TableNextRow();
+		ImGui::TableSetColumnIndex(0);
+		ImGui::Text("CPU (ms): %.3f", frameLength / 1e6);
+		for (const ProfileTotal& total : profiler.LastFrameTotals)
+			ImGui::Text("%-18s %6.3f x%d", total.name, total.milliseconds, total.calls);
+		if (profiler.DroppedEvents > 0)
+			ImGui::Text("Dropped events: %llu", (unsigned long long)profiler.DroppedEvents);
+
+		ImGui::TableSetColumnIndex(1);
+		ImGui::Text("GPU (ms): %.3f", gpuProfiler.LastFrameMilliseconds);
+		for (const GpuProfiler::PassResult& pass : gpuProfiler.LastResults)
+			ImGui::Text("%*s%-14s %6.3f", (int)pass.depth * 2, "", pass.name, pass.milliseconds);
+		if (gpuProfiler.SkippedFrames > 0)
+			ImGui::Text("Skipped readbacks: %d", gpuProfiler.SkippedFrames);
+		ImGui::EndTable();
+	}
+}
+
 void SetLightsToShader(Shader& cubeShader) {
+	PROFILE_SCOPE("SetLightsToShader");
 	cubeShader.use();
-	cubeShader.setVec3("viewPos", camera.Position);
+	cubeShader.setVec3(U_VIEW_POS, camera.Position);
 
-	cubeShader.setVec3("dirLight.direction", -0.2f, -0.2f, -0.2f);
-	cubeShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-	cubeShader.setVec3("dirLight.diffuse", 0.1f, 0.1f, 0.1f);
-	cubeShader.setVec3("dirLight.specular", 0.2f, 0.2f, 0.2f);
+	//lights live in the LightBlock UBO and texture buffer, this is a no-op unless the editor or an animation touched them
+	frameStats.bytesUploaded += lightBlock.Flush();
 
-	for (int i = 0; i < POINT_LIGHT_AMOUNT; i++) {
-		std::string base = "pointLights[" + std::to_string(i) + "]";
+	//the flashlight is set per lit shader in SetLightingUniforms, only the SPOT_LIGHT variants have it
+}
 
-		if (!pointLights[i].enabled) {
-			cubeShader.setVec3(base + ".ambient", 0.0f, 0.0f, 0.0f);
-			cubeShader.setVec3(base + ".diffuse", 0.0f, 0.0f, 0.0f);
-			cubeShader.setVec3(base + ".specular", 0.0f, 0.0f, 0.0f);
-			continue;
+//extra lights spread through a volume that grows with their count (like the cube field), random hues
+void ScatterLights(int count) {
+	if (count <= 0) return;
+
+	float extent = 4.0f * std::cbrt((float)std::max(count, debug.cubeCount));
+	static unsigned int seed = 4242u;
+	auto random01 = []() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+
+	for (int i = 0; i < count; i++) {
+		LightSettings light;
+		light.anchor = glm::vec3((random01() - 0.5f) * extent, (random01() - 0.5f) * extent, -random01() * extent - 3.0f);
+		light.position = light.anchor;
+		glm::vec3 color = glm::clamp(glm::abs(glm::fract(glm::vec3(random01()) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+		light.ambient = glm::vec3(0.0f);
+		light.diffuse = color * 0.5f;
+		light.specular = color * 0.5f;
+		light.linear = 0.7f;
+		light.quadratic = 1.8f;
+		light.orbitRadius = 0.5f + random01();
+		pointLights.push_back(light);
+	}
+}
+
+//scattered lights circle their anchors, every one of them changes every frame
+void AnimateLights() {
+	PROFILE_SCOPE("Animate lights");
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		LightSettings& light = pointLights[i];
+		if (light.orbitRadius <= 0.0f) continue;
+
+		float angle = engineTime * (0.5f + 0.1f * (i % 7)) + i * 2.39996f;
+		light.position = light.anchor + light.orbitRadius * glm::vec3(std::cos(angle), 0.5f * std::sin(angle * 0.7f), std::sin(angle));
+		lightBlock.SetPointLight((int)i, PackPointLight(light));
+	}
+	lightInstancesDirty = true;
+}
+
+//every enabled light as a sphere of its range, capped at the far plane
+void UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection) {
+	PROFILE_SCOPE("Light clusters");
+	clusterLightBounds.Clear();
+	clusterLightOwners.clear();
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		const LightSettings& light = pointLights[i];
+		if (!light.enabled) continue;
+
+		float range = LightRange(light);
+		if (range <= 0.0f) continue;
+
+		clusterLightBounds.Add(light.position, range);
+		clusterLightOwners.push_back((uint32_t)i);
+	}
+
+	frameStats.bytesUploaded += lightClusters.Build(view, projection, CAMERA_NEAR, CAMERA_FAR, clusterLightBounds, clusterLightOwners);
+}
+
+//the features a lit draw needs this frame, anything left out is compiled out of the variant it picks
+uint32_t ActiveShaderFeatures() {
+	uint32_t features = 0;
+	if (dirLightEnabled)
+		features |= FEATURE_DIR_LIGHT;
+	if (flashlight.enabled)
+		features |= FEATURE_SPOT_LIGHT;
+	if (debug.specularMaps)
+		features |= FEATURE_SPECULAR_MAP;
+	if (debug.clusterHeatmap)
+		features |= FEATURE_CLUSTER_HEATMAP;
+	//the cluster loop is worth compiling in once a single light reaches anything
+	for (const LightSettings& light : pointLights) {
+		if (light.enabled && LightRange(light) > 0.0f) {
+			features |= FEATURE_POINT_LIGHTS;
+			break;
 		}
+	}
+	return features;
+}
 
-		cubeShader.setVec3(base + ".position", pointLights[i].position);
-		cubeShader.setVec3(base + ".ambient", pointLights[i].ambient);
-		cubeShader.setVec3(base + ".diffuse", pointLights[i].diffuse);
-		cubeShader.setVec3(base + ".specular", pointLights[i].specular);
-		cubeShader.setFloat(base + ".constant", pointLights[i].constant);
-		cubeShader.setFloat(base + ".linear", pointLights[i].linear);
-		cubeShader.setFloat(base + ".quadratic", pointLights[i].quadratic);
+//per frame state of a lit shader: cluster lookup, light texture buffers and the flashlight
+void SetLightingUniforms(Shader& shader) {
+	shader.use();
+	shader.setVec4(U_CLUSTER_SCALE, lightClusters.ShaderScale(framebufferSize.x, framebufferSize.y));
+	shader.setVec2(U_CLUSTER_DEPTH, glm::vec2(CAMERA_NEAR, CAMERA_FAR));
+
+	if (flashlight.enabled) {
+		shader.setVec3(U_SPOT_POSITION, camera.Position);
+		shader.setVec3(U_SPOT_DIRECTION, camera.Front);
+		shader.setFloat(U_SPOT_CUT_OFF, glm::cos(glm::radians(flashlight.cutOff)));
+		shader.setFloat(U_SPOT_OUTER_CUT_OFF, glm::cos(glm::radians(flashlight.outerCutOff)));
+		shader.setVec3(U_SPOT_AMBIENT, flashlight.ambient);
+		shader.setVec3(U_SPOT_DIFFUSE, flashlight.diffuse);
+		shader.setVec3(U_SPOT_SPECULAR, flashlight.specular);
 	}
 
-	//cubeShader.setVec3("spotLight.position", camera.Position);
-	//cubeShader.setVec3("spotLight.direction", camera.Front);
-	//cubeShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-	//cubeShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	//cubeShader.setVec3("spotLight.ambient", 0.1f, 0.1f, 0.1f);
-	//cubeShader.setVec3("spotLight.diffuse", 0.8f, 0.8f, 0.8f);
-	//cubeShader.setVec3("spotLight.specular", 0.3f, 0.3f, 0.3f);
+	lightBlock.BindPointLights(GL_TEXTURE0 + POINT_LIGHT_UNIT);
+	lightClusters.Bind(GL_TEXTURE0 + CLUSTER_GRID_UNIT, GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+	GLState::Get().ActiveTexture(GL_TEXTURE0);
+}
 
+//scene functions
 
+MeshData BuildCubeMesh(bool optimizeVertexCache) {
+	MeshData mesh = WeldVertices(cubeVertices, sizeof(cubeVertices) / (8 * sizeof(float)));
+	if (optimizeVertexCache)
+		OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	return mesh;
 }
 
-//debug functions
+//--mesh-stats: ACMR of the cube and generated meshes before and after welding/reordering, no window needed
+int RunMeshStats() {
+	auto report = [](const char* name, const MeshData& mesh) {
+		std::cout << std::left << std::setw(32) << name
+			<< " verts " << std::setw(9) << mesh.vertices.size()
+			<< " tris " << std::setw(9) << mesh.indices.size() / 3
+			<< " ACMR " << std::fixed << std::setprecision(3) << ComputeACMR(mesh.indices, mesh.vertices.size()) << std::endl;
+	};
 
-void AddDebugLine(glm::vec3 from, glm::vec3 to, glm::vec3 color) {
-	debugLineVerts.push_back(from);
-	debugLineVerts.push_back(to);
-	debugLineColors.push_back(color);
-	debugLineColors.push_back(color);
+	const size_t soupCount = sizeof(cubeVertices) / (8 * sizeof(float));
+	MeshData soup;
+	soup.vertices.assign(reinterpret_cast<const Vertex*>(cubeVertices), reinterpret_cast<const Vertex*>(cubeVertices) + soupCount);
+	for (unsigned int i = 0; i < soupCount; i++)
+		soup.indices.push_back(i);
+
+	report("cube (triangle soup)", soup);
+	report("cube (welded)", BuildCubeMesh(false));
+	report("cube (welded + forsyth)", BuildCubeMesh(true));
+
+	for (int resolution : { 64, 256, 1024 }) {
+		MeshData sphere = GenerateSphere(resolution, resolution);
+		ShuffleTriangles(sphere.indices);
+
+		std::string name = "sphere " + std::to_string(resolution) + " (shuffled)";
+		report(name.c_str(), sphere);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		OptimizeVertexCache(sphere.indices, sphere.vertices.size());
+		auto end = std::chrono::high_resolution_clock::now();
+
+		name = "sphere " + std::to_string(resolution) + " (forsyth)";
+		report(name.c_str(), sphere);
+		std::cout << "    reorder took " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+	}
+	return 0;
 }
 
-void InitDebugLines() {
-	glGenVertexArrays(1, &debugVAO);
-	glGenBuffers(2, debugVBO);
+//--mesh-load-bench [file.obj]: OBJ parse vs mapped .mesh cache, writes a ~5M triangle sphere first if the file is missing
+int RunMeshLoadBenchmark(const std::string& objPath) {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	FileStamp stamp;
+	if (!GetFileStamp(objPath, stamp)) {
+		std::cout << "Writing " << objPath << "..." << std::endl;
+		MeshData sphere = GenerateSphere(1600, 1600);
+		std::ofstream out(objPath, std::ios::binary);
+		char line[128];
+		for (const Vertex& v : sphere.vertices) {
+			int n = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", v.position.x, v.position.y, v.position.z);
+			out.write(line, n);
+		}
+		for (const Vertex& v : sphere.vertices) {
+			int n = snprintf(line, sizeof(line), "vt %.6f %.6f\n", v.texCoord.x, v.texCoord.y);
+			out.write(line, n);
+		}
+		for (const Vertex& v : sphere.vertices) {
+			int n = snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", v.normal.x, v.normal.y, v.normal.z);
+			out.write(line, n);
+		}
+		for (size_t i = 0; i < sphere.indices.size(); i += 3) {
+			unsigned int a = sphere.indices[i] + 1, b = sphere.indices[i + 1] + 1, c = sphere.indices[i + 2] + 1;
+			int n = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+			out.write(line, n);
+		}
+		out.close();
+		if (!GetFileStamp(objPath, stamp)) {
+			std::cout << "Failed to write " << objPath << std::endl;
+			return -1;
+		}
+	}
 
-	glBindVertexArray(debugVAO);
+	auto parseStart = clock::now();
+	MeshData mesh;
+	if (!LoadObjFile(objPath, mesh)) {
+		std::cout << "Failed to parse " << objPath << std::endl;
+		return -1;
+	}
+	auto parseEnd = clock::now();
 
-	// Positions (VBO 0)
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 1000, nullptr, GL_DYNAMIC_DRAW); // allocate some space
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-	glEnableVertexAttribArray(0);
+	std::string cachePath = objPath + ".mesh";
+	WriteMeshCache(cachePath, mesh, stamp);
 
-	// Colors (VBO 1)
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 1000, nullptr, GL_DYNAMIC_DRAW); // allocate some space
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-	glEnableVertexAttribArray(1);
+	auto cacheStart = clock::now();
+	MeshCacheFile cache;
+	if (!cache.Open(cachePath, &stamp)) {
+		std::cout << "Failed to open " << cachePath << std::endl;
+		return -1;
+	}
+	//touch every page so the timing includes actually reading the data, not just mapping it
+	size_t checksum = 0;
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(cache.Vertices());
+	size_t cacheBytes = cache.VertexCount() * sizeof(Vertex) + cache.IndexCount() * (cache.ShortIndices() ? 2 : 4);
+	for (size_t i = 0; i < cacheBytes; i += 4096)
+		checksum += bytes[i];
+	auto cacheEnd = clock::now();
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "source      " << stamp.size / (1024.0 * 1024.0) << " MB, "
+		<< mesh.vertices.size() << " verts, " << mesh.indices.size() / 3 << " tris" << std::endl
+		<< "obj parse   " << ms(parseStart, parseEnd) << " ms" << std::endl
+		<< "mesh cache  " << ms(cacheStart, cacheEnd) << " ms (" << cacheBytes / (1024.0 * 1024.0) << " MB mapped, checksum " << checksum << ")" << std::endl;
+	return 0;
+}
+
+//--cull-bench: scalar vs SIMD sphere culling over 10k/100k/1M random spheres, best of 20 runs each
+int RunCullingBenchmark() {
+	using clock = std::chrono::high_resolution_clock;
+
+	Camera benchCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(ZOOM), (float)SCR_WIDTH / (float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
+	Frustum frustum = benchCamera.GetFrustum(projection);
+
+#if defined(SPHERE_CULLING_AVX)
+	const char* kernel = "avx";
+#elif defined(SPHERE_CULLING_SSE)
+	const char* kernel = "sse";
+#else
+	const char* kernel = "scalar";
+#endif
+
+	unsigned int seed = 12345u;
+	auto random01 = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
 
-	glBindVertexArray(0);
+	for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 }) {
+		//a box around the camera a bit larger than the far plane, so most spheres end up culled
+		BoundingSpheres spheres;
+		spheres.Reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 center((random01() - 0.5f) * 200.0f, (random01() - 0.5f) * 200.0f, (random01() - 0.5f) * 200.0f);
+			spheres.Add(center, 0.1f + random01());
+		}
+
+		std::vector<uint32_t> scalarVisible(count), simdVisible;
+		size_t scalarCount = 0;
+		double scalarBest = 1e30, simdBest = 1e30;
+		for (int run = 0; run < 20; run++) {
+			auto start = clock::now();
+			scalarCount = CullSpheresScalar(frustum, spheres, 0, scalarVisible.data());
+			auto middle = clock::now();
+			CullSpheres(frustum, spheres, simdVisible);
+			auto end = clock::now();
+
+			scalarBest = std::min(scalarBest, std::chrono::duration<double, std::milli>(middle - start).count());
+			simdBest = std::min(simdBest, std::chrono::duration<double, std::milli>(end - middle).count());
+		}
+		scalarVisible.resize(scalarCount);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << count << " spheres, " << std::setw(7) << simdVisible.size() << " visible"
+			<< "  scalar " << std::setw(8) << scalarBest << " ms"
+			<< "  " << kernel << " " << std::setw(8) << simdBest << " ms"
+			<< "  (" << std::setprecision(2) << scalarBest / simdBest << "x, " << simdBest * 1e6 / count << " ns/sphere)"
+			<< (scalarVisible == simdVisible ? "" : "  MISMATCH") << std::endl;
+		if (scalarVisible != simdVisible)
+			return 1;
+	}
+	return 0;
 }
 
-void RenderDebugLines(Shader debugShader, glm::mat4 view, glm::mat4 projection) {
-	if (debugLineVerts.empty()) return;
+//--job-bench: job spawn overhead (flat and nested) and how a ParallelFor of transform building scales with threads
+int RunJobBenchmark() {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	JobSystem& jobs = JobSystem::Get();
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+
+	jobs.Start();
+	std::cout << std::fixed << std::setprecision(2) << jobs.ThreadCount() << " threads" << std::endl;
+
+	//empty jobs from one thread, what a job costs to spawn, steal and retire
+	const int flatCount = 100000;
+	double flatBest = 1e30;
+	for (int run = 0; run < 10; run++) {
+		JobCounter counter;
+		auto start = clock::now();
+		for (int i = 0; i < flatCount; i++)
+			jobs.Spawn(counter, []() {});
+		jobs.Wait(counter);
+		flatBest = std::min(flatBest, ms(start, clock::now()));
+	}
+	std::cout << "flat spawn   " << std::setw(7) << flatCount << " jobs " << std::setw(8) << flatBest << " ms  ("
+		<< flatBest * 1e6 / flatCount << " ns/job)" << std::endl;
+
+	//a binary tree of children on one counter, every job spawns its two children from whichever thread runs it
+	struct Tree {
+		static void Spawn(JobSystem& jobs, JobCounter& counter, int depth) {
+			if (depth == 0) return;
+			for (int child = 0; child < 2; child++)
+				jobs.Spawn(counter, [&jobs, &counter, depth]() { Tree::Spawn(jobs, counter, depth - 1); });
+		}
+	};
+	const int treeDepth = 16;
+	const int treeCount = (2 << treeDepth) - 2;
+	double treeBest = 1e30;
+	for (int run = 0; run < 10; run++) {
+		JobCounter counter;
+		auto start = clock::now();
+		Tree::Spawn(jobs, counter, treeDepth);
+		jobs.Wait(counter);
+		treeBest = std::min(treeBest, ms(start, clock::now()));
+	}
+	std::cout << "nested spawn " << std::setw(7) << treeCount << " jobs " << std::setw(8) << treeBest << " ms  ("
+		<< treeBest * 1e6 / treeCount << " ns/job)" << std::endl;
+	jobs.Shutdown();
+
+	//model matrices for 1M objects, serially and then with 1, 2, 4 .. hardware threads
+	const size_t objectCount = 1 << 20;
+	std::vector<glm::vec3> positions(objectCount);
+	std::vector<float> angles(objectCount);
+	for (size_t i = 0; i < objectCount; i++) {
+		positions[i] = glm::vec3((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+		angles[i] = (float)i * 0.01f;
+	}
+	std::vector<glm::mat4> serial(objectCount), parallel(objectCount);
+	auto buildModels = [&positions, &angles](std::vector<glm::mat4>& models, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+			model = glm::rotate(model, angles[i], glm::vec3(0.3f, 1.0f, 0.5f));
+			models[i] = glm::scale(model, glm::vec3(0.5f));
+		}
+	};
 
-	debugShader.use();
-	debugShader.setMat4("view", view);
-	debugShader.setMat4("projection", projection);
+	double serialBest = 1e30;
+	for (int run = 0; run < 5; run++) {
+		auto start = clock::now();
+		buildModels(serial, 0, objectCount);
+		serialBest = std::min(serialBest, ms(start, clock::now()));
+	}
+	std::cout << "transforms   " << objectCount << " serial " << std::setw(8) << serialBest << " ms" << std::endl;
+
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < hardware; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardware);
+
+	for (unsigned int threads : threadCounts) {
+		//one thread means no workers at all, the calling thread then runs every range itself
+		if (threads > 1)
+			jobs.Start(threads - 1);
+		double best = 1e30;
+		for (int run = 0; run < 5; run++) {
+			auto start = clock::now();
+			jobs.ParallelFor(objectCount, 4096, [&](size_t begin, size_t end) { buildModels(parallel, begin, end); });
+			best = std::min(best, ms(start, clock::now()));
+		}
+		if (threads > 1)
+			jobs.Shutdown();
+
+		bool match = std::memcmp(serial.data(), parallel.data(), objectCount * sizeof(glm::mat4)) == 0;
+		std::cout << "transforms   " << std::setw(2) << threads << " threads " << std::setw(8) << best << " ms  ("
+			<< serialBest / best << "x)" << (match ? "" : "  MISMATCH") << std::endl;
+		if (!match)
+			return 1;
+	}
+	return 0;
+}
+
+//--transform-bench [count]: TransformHierarchy updates, default 1M nodes in 4 levels (1/8 roots, each level's parents
+//picked from the one before), full, static, and with 1% of the roots moved
+int RunTransformBenchmark(size_t count) {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	JobSystem::Get().Start();
+
+	unsigned int seed = 12345u;
+	auto random01 = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+	auto randomRotation = [&random01]() {
+		glm::vec3 axis(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f);
+		return glm::angleAxis(random01() * 6.2831853f, glm::normalize(axis + glm::vec3(0.0f, 0.01f, 0.0f)));
+	};
+
+	TransformHierarchy transforms;
+	transforms.Reserve(count);
+	size_t levelStart = 0, levelEnd = 0;
+	size_t levelSizes[4] = { count / 8, count * 2 / 8, count * 2 / 8, 0 };
+	levelSizes[3] = count - levelSizes[0] - levelSizes[1] - levelSizes[2];
+	for (int level = 0; level < 4; level++) {
+		for (size_t i = 0; i < levelSizes[level]; i++) {
+			uint32_t parent = level == 0 ? TransformHierarchy::NO_PARENT
+				: (uint32_t)(levelStart + (size_t)(random01() * (levelEnd - levelStart - 1)));
+			glm::vec3 position((random01() - 0.5f) * 10.0f, (random01() - 0.5f) * 10.0f, (random01() - 0.5f) * 10.0f);
+			transforms.Add(position, randomRotation(), glm::vec3(0.5f + random01()), parent);
+		}
+		levelStart = levelEnd;
+		levelEnd = transforms.Size();
+	}
+
+	std::cout << std::fixed << std::setprecision(3) << count << " nodes, " << JobSystem::Get().ThreadCount() << " threads" << std::endl;
+
+	//every node, what the first frame (or a rebuild) costs
+	double fullBest = 1e30;
+	for (int run = 0; run < 5; run++) {
+		transforms.Invalidate();
+		auto start = clock::now();
+		transforms.Update();
+		fullBest = std::min(fullBest, ms(start, clock::now()));
+	}
+	std::cout << "full update      " << std::setw(9) << fullBest << " ms (" << fullBest * 1e6 / count << " ns/node)" << std::endl;
+
+	//the same with glm, one node after the other, and the largest difference to it
+	std::vector<glm::mat4> reference(count);
+	auto start = clock::now();
+	for (size_t i = 0; i < count; i++) {
+		uint32_t node = (uint32_t)i;
+		glm::mat4 local = TransformHierarchy::LocalMatrix(transforms.Position(node), transforms.Rotation(node), transforms.Scale(node));
+		uint32_t parent = transforms.Parent(node);
+		reference[i] = parent == TransformHierarchy::NO_PARENT ? local : reference[parent] * local;
+	}
+	double referenceMs = ms(start, clock::now());
+	float maxError = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		for (int column = 0; column < 4; column++)
+			maxError = std::max(maxError, glm::compMax(glm::abs(transforms.World((uint32_t)i)[column] - reference[i][column])));
+	std::cout << "glm reference    " << std::setw(9) << referenceMs << " ms, max difference " << std::scientific << maxError
+		<< std::fixed << std::endl;
+
+	//nothing moved
+	const int staticRuns = 1000;
+	start = clock::now();
+	for (int run = 0; run < staticRuns; run++)
+		transforms.Update();
+	double staticNs = ms(start, clock::now()) * 1e6 / staticRuns;
+	std::cout << "static update    " << std::setw(9) << staticNs << " ns" << std::endl;
+
+	//1% of the roots moved, their subtrees follow
+	size_t roots = levelSizes[0];
+	size_t moved = std::max<size_t>(1, roots / 100);
+	double movedBest = 1e30;
+	size_t changed = 0;
+	for (int run = 0; run < 5; run++) {
+		for (size_t i = 0; i < moved; i++) {
+			uint32_t node = (uint32_t)(random01() * (roots - 1));
+			transforms.SetPosition(node, transforms.Position(node) + glm::vec3(0.1f, 0.0f, 0.0f));
+		}
+		auto moveStart = clock::now();
+		changed = transforms.Update();
+		movedBest = std::min(movedBest, ms(moveStart, clock::now()));
+	}
+	std::cout << "1% roots moved   " << std::setw(9) << movedBest << " ms (" << changed << " nodes changed)" << std::endl;
+
+	JobSystem::Get().Shutdown();
+	return maxError < 1e-3f ? 0 : 1;
+}
+
+//--bvh-bench [count]: AABB tree build/refit/reinsert and query times, default 1M boxes scattered like the cube field
+int RunTreeBenchmark(size_t count) {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	unsigned int seed = 12345u;
+	auto random01 = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+
+	float extent = 4.0f * std::cbrt((float)count);
+	std::vector<AABB> boxes(count);
+	std::vector<uint32_t> ids(count);
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 center((random01() - 0.5f) * extent, (random01() - 0.5f) * extent, (random01() - 0.5f) * extent);
+		glm::vec3 half(0.25f + random01() * 0.5f);
+		boxes[i] = { center - half, center + half };
+		ids[i] = (uint32_t)i;
+	}
+
+	AABBTree tree;
+	std::vector<int> proxies;
+	auto start = clock::now();
+	tree.Build(boxes, ids, proxies);
+	auto end = clock::now();
+	std::cout << std::fixed << std::setprecision(2)
+		<< count << " boxes" << std::endl
+		<< "SAH build        " << ms(start, end) << " ms, height " << tree.Height() << std::endl;
+
+	//the same boxes one at a time, the path objects take when they are added at runtime
+	AABBTree incremental;
+	start = clock::now();
+	for (size_t i = 0; i < count; i++)
+		incremental.CreateProxy(boxes[i], ids[i]);
+	end = clock::now();
+	std::cout << "insert one by one " << ms(start, end) << " ms, height " << incremental.Height() << std::endl;
+
+	//every box drifts a little: leaves updated in place, then one bottom up pass
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 offset(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f);
+		boxes[i].min += offset * 0.2f;
+		boxes[i].max += offset * 0.2f;
+	}
+	start = clock::now();
+	for (size_t i = 0; i < count; i++)
+		tree.SetProxyBox(proxies[i], boxes[i]);
+	tree.Refit();
+	end = clock::now();
+	std::cout << "refit all        " << ms(start, end) << " ms" << std::endl;
+
+	//1% jump somewhere else, each is removed and reinserted
+	size_t moved = std::max<size_t>(1, count / 100);
+	start = clock::now();
+	for (size_t i = 0; i < moved; i++) {
+		size_t index = (size_t)(random01() * (count - 1));
+		glm::vec3 center((random01() - 0.5f) * extent, (random01() - 0.5f) * extent, (random01() - 0.5f) * extent);
+		glm::vec3 half = boxes[index].Extent() * 0.5f;
+		boxes[index] = { center - half, center + half };
+		tree.MoveProxy(proxies[index], boxes[index]);
+	}
+	end = clock::now();
+	std::cout << "reinsert " << moved << "  " << ms(start, end) << " ms, height " << tree.Height() << std::endl;
+
+	//frustum from the middle of the volume against the tree and against every box
+	Camera benchCamera(glm::vec3(0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(ZOOM), (float)SCR_WIDTH / (float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
+	Frustum frustum = benchCamera.GetFrustum(projection);
+
+	size_t treeVisible = 0, linearVisible = 0;
+	start = clock::now();
+	for (int run = 0; run < 10; run++) {
+		treeVisible = 0;
+		tree.QueryFrustum(frustum, [&treeVisible](uint32_t) { treeVisible++; });
+	}
+	end = clock::now();
+	double treeMs = ms(start, end) / 10.0;
+
+	start = clock::now();
+	for (int run = 0; run < 10; run++) {
+		linearVisible = 0;
+		for (size_t i = 0; i < count; i++)
+			linearVisible += ClassifyAABB(frustum, tree.FatBox(proxies[i])) != FrustumTest::Outside;
+	}
+	end = clock::now();
+	std::cout << "frustum query    " << treeMs << " ms (" << treeVisible << " visible), linear " << ms(start, end) / 10.0
+		<< " ms (" << linearVisible << " visible)" << std::endl;
+
+	//rays from the centre in random directions, closest box hit
+	const int rayCount = 10000;
+	auto boxHit = [&tree, &proxies](const glm::vec3& origin, const glm::vec3& direction) {
+		glm::vec3 inverseDirection = 1.0f / direction;
+		return [&tree, &proxies, origin, inverseDirection](uint32_t id, float maxDistance, float& distance) {
+			return RayIntersectsAABB(origin, inverseDirection, tree.FatBox(proxies[id]), maxDistance, distance);
+		};
+	};
+	int hits = 0;
+	start = clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		glm::vec3 direction = glm::normalize(glm::vec3(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f) + glm::vec3(1e-4f));
+		uint32_t hitId;
+		float hitDistance;
+		hits += tree.RayCast(glm::vec3(0.0f), direction, 1e30f, boxHit(glm::vec3(0.0f), direction), hitId, hitDistance);
+	}
+	end = clock::now();
+	std::cout << "ray cast         " << ms(start, end) * 1000.0 / rayCount << " us/ray (" << hits << "/" << rayCount << " hit)" << std::endl;
+
+	const int sphereCount = 10000;
+	size_t overlaps = 0;
+	start = clock::now();
+	for (int q = 0; q < sphereCount; q++) {
+		glm::vec3 center((random01() - 0.5f) * extent, (random01() - 0.5f) * extent, (random01() - 0.5f) * extent);
+		tree.QuerySphere(center, 2.0f, [&overlaps](uint32_t) { overlaps++; });
+	}
+	end = clock::now();
+	std::cout << "sphere query     " << ms(start, end) * 1000.0 / sphereCount << " us/query (" << (double)overlaps / sphereCount << " overlaps avg)" << std::endl;
+	return 0;
+}
+
+//--cook-textures [images...]: writes <image>.ctex for each image and checks the round trip, no window needed
+//an image below the format's PSNR floor or the compression ratio floor fails the run, like an I/O error
+const double COOK_MIN_PSNR_BC1 = 32.0;
+const double COOK_MIN_PSNR_BC3 = 32.0;
+const double COOK_MIN_RATIO = 3.9;		//against RGBA8 with mips, BC3 is 4x before the header
+
+int RunTextureCook(const std::vector<std::string>& paths) {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+	int failures = 0;
+
+	for (const std::string& path : paths) {
+		FileStamp stamp;
+		int width, height, channels;
+
+		auto decodeStart = clock::now();
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		auto decodeEnd = clock::now();
+		if (!pixels || !GetFileStamp(path, stamp)) {
+			std::cout << path << ": failed to load" << std::endl;
+			failures++;
+			continue;
+		}
+
+		std::string cookedPath = path + ".ctex";
+		auto cookStart = clock::now();
+		bool written = CookCompressedTexture(cookedPath, pixels, width, height, 4, true, stamp);
+		auto cookEnd = clock::now();
+
+		auto openStart = clock::now();
+		CompressedTextureFile cooked;
+		bool opened = written && cooked.Open(cookedPath, &stamp, 1);
+		auto openEnd = clock::now();
+		if (!opened) {
+			std::cout << path << ": failed to write " << cookedPath << std::endl;
+			stbi_image_free(pixels);
+			failures++;
+			continue;
+		}
+
+		//PSNR of the top level, RGB only (alpha is exact for opaque images)
+		std::vector<unsigned char> decoded((size_t)width * height * 4);
+		DecompressImage(cooked.LevelData(0), width, height, cooked.Format(), decoded.data());
+		double squaredError = 0.0;
+		for (size_t i = 0; i < (size_t)width * height; i++) {
+			for (int k = 0; k < 3; k++) {
+				double d = (double)pixels[i * 4 + k] - decoded[i * 4 + k];
+				squaredError += d * d;
+			}
+		}
+		double mse = squaredError / ((double)width * height * 3);
+		double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+
+		size_t uncompressedBytes = (size_t)width * height * 4 * 4 / 3;
+		double ratio = (double)uncompressedBytes / cooked.FileSize();
+		double minPsnr = cooked.Format() == BlockFormat::BC1 ? COOK_MIN_PSNR_BC1 : COOK_MIN_PSNR_BC3;
+		std::cout << std::fixed << std::setprecision(2)
+			<< path << ": " << width << "x" << height << " " << channels << "ch -> "
+			<< (cooked.Format() == BlockFormat::BC1 ? "BC1" : "BC3") << ", " << cooked.LevelCount() << " levels" << std::endl
+			<< "    png decode " << ms(decodeStart, decodeEnd) << " ms, cook " << ms(cookStart, cookEnd) << " ms ("
+			<< (width * height / 1000000.0) / (ms(cookStart, cookEnd) / 1000.0) << " MP/s), mapped open " << ms(openStart, openEnd) << " ms" << std::endl
+			<< "    " << cooked.FileSize() / 1024.0 << " KB vs " << uncompressedBytes / 1024.0 << " KB RGBA8 with mips ("
+			<< ratio << "x), PSNR " << psnr << " dB" << std::endl;
+		if (psnr < minPsnr) {
+			std::cout << "    FAIL: PSNR below " << minPsnr << " dB" << std::endl;
+			failures++;
+		}
+		if (ratio < COOK_MIN_RATIO) {
+			std::cout << "    FAIL: compression ratio below " << COOK_MIN_RATIO << "x" << std::endl;
+			failures++;
+		}
 
-	glBindVertexArray(debugVAO);
+		stbi_image_free(pixels);
+	}
+	return failures == 0 ? 0 : -1;
+}
 
-	// Upload vertex data
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, debugLineVerts.size() * sizeof(glm::vec3), &debugLineVerts[0], GL_DYNAMIC_DRAW);
+//0 when the frame matches the golden image within --tolerance, 1 when it doesn't, -1 when the golden can't be read
+int CompareWithGolden(const std::vector<unsigned char>& rgb, int width, int height, ImageDiff& diff) {
+	int goldenWidth, goldenHeight, goldenChannels;
+	stbi_set_flip_vertically_on_load(false);
+	unsigned char* golden = stbi_load(headless.goldenPath.c_str(), &goldenWidth, &goldenHeight, &goldenChannels, 3);
+	if (!golden) {
+		std::cout << "Failed to load golden image " << headless.goldenPath << std::endl;
+		return -1;
+	}
+	if (goldenWidth != width || goldenHeight != height) {
+		std::cout << "Golden image is " << goldenWidth << "x" << goldenHeight << ", frame is " << width << "x" << height << std::endl;
+		stbi_image_free(golden);
+		return -1;
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, debugVBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, debugLineColors.size() * sizeof(glm::vec3), &debugLineColors[0], GL_DYNAMIC_DRAW);
+	diff = ComparePerceptual(rgb.data(), golden, (size_t)width * height);
+	stbi_image_free(golden);
 
-	glDrawArrays(GL_LINES, 0, debugLineVerts.size());
+	bool pass = diff.percentAboveJnd <= headless.tolerance;
+	std::cout << std::fixed << std::setprecision(3) << "Golden " << (pass ? "PASS" : "FAIL")
+		<< ": mean dE " << diff.meanDeltaE << ", max dE " << diff.maxDeltaE
+		<< ", " << diff.percentAboveJnd << "% pixels above JND (tolerance " << headless.tolerance << "%)" << std::endl;
+	return pass ? 0 : 1;
+}
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+bool WriteHeadlessReport(const std::string& path, const std::vector<HeadlessFrame>& frames, const ImageDiff* golden) {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out)
+		return false;
+
+	//mean/min/max/p50/p95 over the frames that have a value
+	auto summary = [&out](const char* name, std::vector<double> values) {
+		values.erase(std::remove(values.begin(), values.end(), 0.0), values.end());
+		out << "\t\"" << name << "\": { ";
+		if (values.empty()) {
+			out << "\"samples\": 0 }";
+			return;
+		}
+		std::sort(values.begin(), values.end());
+		double sum = 0.0;
+		for (double v : values) sum += v;
+		out << "\"samples\": " << values.size()
+			<< ", \"mean\": " << sum / values.size()
+			<< ", \"min\": " << values.front()
+			<< ", \"max\": " << values.back()
+			<< ", \"p50\": " << values[values.size() / 2]
+			<< ", \"p95\": " << values[std::min(values.size() - 1, values.size() * 95 / 100)] << " }";
+	};
+
+	std::vector<double> cpu, gpu;
+	long long glIssued = 0, glElided = 0, drawCalls = 0, bytesUploaded = 0;
+	for (const HeadlessFrame& frame : frames) {
+		cpu.push_back(frame.cpuMilliseconds);
+		gpu.push_back(frame.gpuMilliseconds);
+		glIssued += frame.glCallsIssued;
+		glElided += frame.glCallsElided;
+		drawCalls += frame.drawCalls;
+		bytesUploaded += (long long)frame.bytesUploaded;
+	}
+	double frameCount = (double)std::max<size_t>(frames.size(), 1);
+
+	out << std::fixed << std::setprecision(4);
+	out << "{\n";
+	out << "\t\"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+	out << "\t\"width\": " << SCR_WIDTH << ", \"height\": " << SCR_HEIGHT << ", \"frames\": " << frames.size() << ",\n";
+	out << "\t\"gpuLagFrames\": " << GpuProfiler::FRAME_LATENCY - 1 << ",\n";
+	summary("cpuFrameMs", cpu);
+	out << ",\n";
+	summary("gpuFrameMs", gpu);
+	out << ",\n";
+	out << "\t\"glStateCalls\": { \"issued\": " << glIssued << ", \"elided\": " << glElided << " },\n";
+	const ProgramCache& programCache = ProgramCache::Get();
+	std::string cacheDirectory = programCache.Directory();
+	for (size_t at = cacheDirectory.find('\\'); at != std::string::npos; at = cacheDirectory.find('\\', at + 2))
+		cacheDirectory.insert(at, 1, '\\');
+	out << "\t\"programCache\": { \"directory\": \"" << cacheDirectory << "\", \"binaries\": " << (programCache.BinariesEnabled() ? "true" : "false")
+		<< ", \"hits\": " << programCache.Hits << ", \"misses\": " << programCache.Misses << ", \"rejected\": " << programCache.Rejected
+		<< ", \"stored\": " << programCache.Stored << ", \"writeFailures\": " << programCache.WriteFailures << " },\n";
+	//run once with and once without --no-instancing to compare the two cube paths
+	out << "\t\"drawPath\": { \"instancing\": " << (debug.instancedRendering ? "true" : "false") << ", \"cubes\": " << debug.cubeCount
+		<< ", \"drawCallsPerFrame\": " << drawCalls / frameCount << ", \"bytesUploadedPerFrame\": " << bytesUploaded / frameCount
+		<< ", \"bytesUploaded\": " << bytesUploaded << " },\n";
+	if (golden) {
+		out << "\t\"golden\": { \"meanDeltaE\": " << golden->meanDeltaE << ", \"maxDeltaE\": " << golden->maxDeltaE
+			<< ", \"percentAboveJnd\": " << golden->percentAboveJnd << ", \"tolerance\": " << headless.tolerance
+			<< ", \"pass\": " << (golden->percentAboveJnd <= headless.tolerance ? "true" : "false") << " },\n";
+	}
 
-	// Clear after drawing
-	debugLineVerts.clear();
-	debugLineColors.clear();
+	out << "\t\"perFrame\": [\n";
+	for (size_t i = 0; i < frames.size(); i++) {
+		const HeadlessFrame& frame = frames[i];
+		out << "\t\t{ \"cpuMs\": " << frame.cpuMilliseconds << ", \"gpuMs\": " << frame.gpuMilliseconds
+			<< ", \"glIssued\": " << frame.glCallsIssued << ", \"glElided\": " << frame.glCallsElided
+			<< ", \"drawCalls\": " << frame.drawCalls << ", \"bytesUploaded\": " << frame.bytesUploaded << ", \"cpuScopes\": {";
+		for (size_t s = 0; s < frame.cpuScopes.size(); s++)
+			out << (s ? ", " : " ") << "\"" << frame.cpuScopes[s].name << "\": " << frame.cpuScopes[s].milliseconds;
+		out << " }, \"gpuPasses\": {";
+		for (size_t p = 0; p < frame.gpuPasses.size(); p++)
+			out << (p ? ", " : " ") << "\"" << frame.gpuPasses[p].name << "\": " << frame.gpuPasses[p].milliseconds;
+		out << " } }" << (i + 1 < frames.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n}\n";
+	return (bool)out;
 }
 
-std::vector<glm::vec3> ExtractPositions(const float* vertices, size_t count) {
-	std::vector<glm::vec3> positions;
-	for (size_t i = 0; i < count; ++i) {
-		glm::vec3 pos(vertices[i * 8 + 0], vertices[i * 8 + 1], vertices[i * 8 + 2]);
-		positions.push_back(pos);
+void AddCubeTransforms(TransformHierarchy& transforms, int count, const glm::vec3* basePositions, int baseCount) {
+	transforms.Reserve(transforms.Size() + count);
+
+	//past the hand placed cubes, scatter the rest through a volume that grows with the count
+	float extent = 4.0f * std::cbrt((float)count);
+	unsigned int seed = 12345u;
+	auto random01 = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+
+	const glm::vec3 axis = glm::normalize(glm::vec3(0.5f, 1.0f, 0.0f));
+	for (int i = 0; i < count; i++) {
+		glm::vec3 position = i < baseCount
+			? basePositions[i]
+			: glm::vec3((random01() - 0.5f) * extent, (random01() - 0.5f) * extent, -random01() * extent - 3.0f);
+
+		float angle = 20.0f * i;
+		transforms.Add(position, glm::angleAxis(glm::radians(angle), axis));
 	}
-	return positions;
 }
 
-std::vector<glm::vec3> ExtractNormals(const float* vertices, size_t count) {
-	std::vector<glm::vec3> normals;
-	for (size_t i = 0; i < count; ++i) {
-		glm::vec3 norm(vertices[i * 8 + 3], vertices[i * 8 + 4], vertices[i * 8 + 5]);
-		normals.push_back(norm);
+//one node per point light after the cubes, at light cube size; lights that moved are flagged for the next Update
+void SyncLightTransforms() {
+	if (sceneTransforms.Size() - cubeNodeCount != pointLights.size()) {
+		//added or removed, the indices after it shift, so all light nodes are rebuilt
+		sceneTransforms.Truncate(cubeNodeCount);
+		for (const LightSettings& light : pointLights)
+			sceneTransforms.Add(light.position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f));
+		return;
+	}
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		uint32_t node = cubeNodeCount + (uint32_t)i;
+		if (sceneTransforms.Position(node) != pointLights[i].position)
+			sceneTransforms.SetPosition(node, pointLights[i].position);
 	}
-	return normals;
 }
 
-void ShowLightFromSurface(glm::vec3 lightDir, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const glm::mat4& model) {
-	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+void BuildCubeInstances(const glm::mat4* models, size_t count, std::vector<InstanceData>& instances) {
+	//AddCubeTransforms only translates and rotates, so the rigid path applies
+	std::vector<glm::mat3> normalMatrices(count);
+	NormalMatrices(models, normalMatrices.data(), count, true);
 
-	for (size_t i = 0; i < positions.size(); ++i) {
-		glm::vec3 worldPos = glm::vec3(model * glm::vec4(positions[i], 1.0f));
+	instances.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		instances[i].model = models[i];
+		instances[i].normalMatrix = normalMatrices[i];
+		instances[i].color = glm::vec3(1.0f);
+	}
+}
 
-		glm::vec3 end = worldPos + (-lightDir) * 0.3f;
-		AddDebugLine(worldPos, end, glm::vec3(0.0f, 1.0f, 0.0f)); // green lines
+//a sphere around each cube, centred on the translation and scaled by the largest axis
+void BuildCubeBounds(const glm::mat4* models, size_t count, BoundingSpheres& bounds) {
+	bounds.Clear();
+	bounds.Reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		const glm::mat4& model = models[i];
+		float scale2 = std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+			std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+		bounds.Add(glm::vec3(model[3]), CUBE_BOUNDING_RADIUS * std::sqrt(scale2));
 	}
 }
 
-void ShowNormals(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const glm::mat4& model) {
-	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+void BuildLightInstances(const std::vector<uint32_t>& lights, std::vector<InstanceData>& instances) {
+	instances.clear();
+	for (uint32_t index : lights) {
+		const LightSettings& light = pointLights[index];
 
-	for (size_t i = 0; i < positions.size(); ++i) {
-		glm::vec3 worldPos = glm::vec3(model * glm::vec4(positions[i], 1.0f));
-		glm::vec3 worldNorm = glm::normalize(normalMatrix * normals[i]);
+		InstanceData instance;
+		instance.model = sceneTransforms.World(cubeNodeCount + index);
+		instance.normalMatrix = glm::mat3(1.0f);
+		instance.color = light.diffuse;
+		instances.push_back(instance);
+	}
+}
 
-		glm::vec3 normalEnd = worldPos + worldNorm * 0.2f;
-		AddDebugLine(worldPos, normalEnd, glm::vec3(0, 0, 1)); //blue lines
+//indices of the objects whose bounds touch the frustum, everything when culling is switched off
+void CullObjects(const Frustum& frustum, const BoundingSpheres& bounds, std::vector<uint32_t>& visible) {
+	if (debug.cullMode != CULL_OFF) {
+		CullSpheres(frustum, bounds, visible);
 	}
+	else {
+		visible.resize(bounds.Size());
+		for (size_t i = 0; i < visible.size(); i++)
+			visible[i] = (uint32_t)i;
+	}
+	frameStats.objectsVisible += (int)visible.size();
+	frameStats.objectsCulled += (int)(bounds.Size() - visible.size());
+}
+
+//SAH build over the cubes, the light proxies go back in afterwards
+void BuildSceneTree(const glm::mat4* models, size_t count) {
+	std::vector<AABB> boxes(count);
+	std::vector<uint32_t> ids(count);
+	for (size_t i = 0; i < count; i++) {
+		boxes[i] = TransformedUnitCube(models[i]);
+		ids[i] = (uint32_t)i;
+	}
+	sceneTree.Build(boxes, ids, cubeProxies);
+	lightProxies.clear();
+}
+
+//one proxy per enabled light, a moved light is only reinserted once it leaves its fat box
+void SyncLightProxies() {
+	lightProxies.resize(pointLights.size(), AABBTree::NULL_NODE);
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		const LightSettings& light = pointLights[i];
+		int& proxy = lightProxies[i];
+		if (!light.enabled) {
+			if (proxy != AABBTree::NULL_NODE)
+				sceneTree.DestroyProxy(proxy);
+			proxy = AABBTree::NULL_NODE;
+			continue;
+		}
+
+		AABB box = { light.position - glm::vec3(0.1f), light.position + glm::vec3(0.1f) };
+		if (proxy == AABBTree::NULL_NODE)
+			proxy = sceneTree.CreateProxy(box, (uint32_t)i | LIGHT_PROXY_BIT);
+		else
+			sceneTree.MoveProxy(proxy, box);
+		//indices shift when a light before this one is removed
+		sceneTree.SetProxyUserData(proxy, (uint32_t)i | LIGHT_PROXY_BIT);
+	}
+}
+
+void CullSceneTree(const Frustum& frustum) {
+	visibleCubes.clear();
+	visibleLights.clear();
+	sceneTree.QueryFrustum(frustum, [](uint32_t object) {
+		if (object & LIGHT_PROXY_BIT)
+			visibleLights.push_back(object & ~LIGHT_PROXY_BIT);
+		else
+			visibleCubes.push_back(object);
+	});
+
+	int visible = (int)(visibleCubes.size() + visibleLights.size());
+	frameStats.objectsVisible += visible;
+	frameStats.objectsCulled += sceneTree.ProxyCount() - visible;
+}
+
+//ray through the cursor against the tree, leaves get an exact test: the cube's triangles in object space, a sphere for lights
+void PickObject(const glm::vec2& cursor, const glm::mat4& projection, const glm::mat4& view) {
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec2 ndc = cursor * 2.0f - 1.0f;
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+	auto exactHit = [&origin, &direction](uint32_t object, float maxDistance, float& distance) {
+		if (object & LIGHT_PROXY_BIT) {
+			const LightSettings& light = pointLights[object & ~LIGHT_PROXY_BIT];
+			float radius = CUBE_BOUNDING_RADIUS * 0.2f;
+			return glm::intersectRaySphere(origin, direction, light.position, radius * radius, distance) && distance < maxDistance;
+		}
+
+		//object space ray, direction left unnormalised so the hit distance stays in world units
+		glm::mat4 toObject = glm::inverse(sceneTransforms.World(object));
+		glm::vec3 localOrigin = glm::vec3(toObject * glm::vec4(origin, 1.0f));
+		glm::vec3 localDirection = glm::vec3(toObject * glm::vec4(direction, 0.0f));
+
+		bool hit = false;
+		distance = maxDistance;
+		const size_t vertexCount = sizeof(cubeVertices) / (8 * sizeof(float));
+		for (size_t i = 0; i < vertexCount; i += 3) {
+			const float* v = cubeVertices + i * 8;
+			glm::vec3 barycentric;
+			if (glm::intersectRayTriangle(localOrigin, localDirection, glm::vec3(v[0], v[1], v[2]), glm::vec3(v[8], v[9], v[10]), glm::vec3(v[16], v[17], v[18]), barycentric)
+				&& barycentric.z < distance) {
+				distance = barycentric.z;
+				hit = true;
+			}
+		}
+		return hit;
+	};
+
+	pick.hit = sceneTree.RayCast(origin, direction, 100.0f, exactHit, pick.object, pick.distance);
+	if (pick.hit && (pick.object & LIGHT_PROXY_BIT))
+		selectedLight = (int)(pick.object & ~LIGHT_PROXY_BIT);
+}
+
+//counting stand-ins for the GL entry points a Shader touches, --uniform-bench swaps them into glad's function pointers
+//the mock program's active uniforms are whatever names the benchmark puts in, locations are their indices
+struct MockUniformGL {
+	std::vector<std::string> names;
+	std::unordered_map<std::string, GLint> locations;
+	size_t locationQueries = 0;
+	size_t uniformCalls = 0;
+
+	static MockUniformGL& Get()
+	{
+		static MockUniformGL instance;
+		return instance;
+	}
+
+	static GLuint APIENTRY CreateProgram() { return 1; }
+	static void APIENTRY DeleteProgram(GLuint) {}
+	static GLuint APIENTRY CreateShader(GLenum type) { return type; }
+	static void APIENTRY DeleteShader(GLuint) {}
+	static void APIENTRY ShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) {}
+	static void APIENTRY CompileShader(GLuint) {}
+	static void APIENTRY AttachShader(GLuint, GLuint) {}
+	static void APIENTRY LinkProgram(GLuint) {}
+	static void APIENTRY GetShaderiv(GLuint, GLenum, GLint* value) { *value = GL_TRUE; }
+
+	static void APIENTRY GetProgramiv(GLuint, GLenum name, GLint* value)
+	{
+		const std::vector<std::string>& names = Get().names;
+		size_t longest = 0;
+		for (const std::string& uniform : names)
+			longest = std::max(longest, uniform.size());
+		*value = name == GL_ACTIVE_UNIFORMS ? (GLint)names.size() : name == GL_ACTIVE_UNIFORM_MAX_LENGTH ? (GLint)longest + 1 : GL_TRUE;
+	}
+
+	static void APIENTRY GetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+	{
+		const std::string& uniform = Get().names[index];
+		GLsizei copied = std::min((GLsizei)uniform.size(), bufSize - 1);
+		std::memcpy(name, uniform.c_str(), copied);
+		name[copied] = '\0';
+		*length = copied;
+		*size = 1;
+		*type = GL_FLOAT_VEC3;
+	}
+
+	static GLint APIENTRY GetUniformLocation(GLuint, const GLchar* name)
+	{
+		MockUniformGL& gl = Get();
+		gl.locationQueries++;
+		auto found = gl.locations.find(name);
+		return found == gl.locations.end() ? -1 : found->second;
+	}
+
+	static void APIENTRY Uniform1i(GLint, GLint) { Get().uniformCalls++; }
+	static void APIENTRY Uniform1f(GLint, GLfloat) { Get().uniformCalls++; }
+	static void APIENTRY Uniform3f(GLint, GLfloat, GLfloat, GLfloat) { Get().uniformCalls++; }
+	static void APIENTRY Uniform3fv(GLint, GLsizei, const GLfloat*) { Get().uniformCalls++; }
+	static void APIENTRY UniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) { Get().uniformCalls++; }
+};
+
+//--uniform-bench: the light uniforms the old SetLightsToShader set every frame (4 point lights) plus the per object
+//matrices, through a glGetUniformLocation per call (what the setters did before the uniform table), the string setters
+//and the id setters; GL is MockUniformGL, so this measures the CPU side only and needs no context
+int RunUniformBenchmark() {
+	using clock = std::chrono::high_resolution_clock;
+	auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	const int lightCount = 4;
+	const char* lightFields[] = { "position", "ambient", "diffuse", "specular", "constant", "linear", "quadratic" };
+	const char* dirLightFields[] = { "dirLight.direction", "dirLight.ambient", "dirLight.diffuse", "dirLight.specular" };
+	const char* matrices[] = { "projection", "view", "model" };
+
+	MockUniformGL& gl = MockUniformGL::Get();
+	gl.names = { "viewPos" };
+	gl.names.insert(gl.names.end(), std::begin(dirLightFields), std::end(dirLightFields));
+	for (int i = 0; i < lightCount; i++)
+		for (const char* field : lightFields)
+			gl.names.push_back("pointLights[" + std::to_string(i) + "]." + field);
+	gl.names.insert(gl.names.end(), std::begin(matrices), std::end(matrices));
+	for (size_t i = 0; i < gl.names.size(); i++)
+		gl.locations[gl.names[i]] = (GLint)i;
+
+	//glad's entry points are plain function pointers, kept to put back afterwards
+	auto saved = std::make_tuple(glad_glCreateProgram, glad_glDeleteProgram, glad_glCreateShader, glad_glDeleteShader, glad_glShaderSource,
+		glad_glCompileShader, glad_glAttachShader, glad_glLinkProgram, glad_glGetShaderiv, glad_glGetProgramiv, glad_glGetActiveUniform,
+		glad_glGetUniformLocation, glad_glUniform1i, glad_glUniform1f, glad_glUniform3f, glad_glUniform3fv, glad_glUniformMatrix4fv);
+	glad_glCreateProgram = MockUniformGL::CreateProgram;
+	glad_glDeleteProgram = MockUniformGL::DeleteProgram;
+	glad_glCreateShader = MockUniformGL::CreateShader;
+	glad_glDeleteShader = MockUniformGL::DeleteShader;
+	glad_glShaderSource = MockUniformGL::ShaderSource;
+	glad_glCompileShader = MockUniformGL::CompileShader;
+	glad_glAttachShader = MockUniformGL::AttachShader;
+	glad_glLinkProgram = MockUniformGL::LinkProgram;
+	glad_glGetShaderiv = MockUniformGL::GetShaderiv;
+	glad_glGetProgramiv = MockUniformGL::GetProgramiv;
+	glad_glGetActiveUniform = MockUniformGL::GetActiveUniform;
+	glad_glGetUniformLocation = MockUniformGL::GetUniformLocation;
+	glad_glUniform1i = MockUniformGL::Uniform1i;
+	glad_glUniform1f = MockUniformGL::Uniform1f;
+	glad_glUniform3f = MockUniformGL::Uniform3f;
+	glad_glUniform3fv = MockUniformGL::Uniform3fv;
+	glad_glUniformMatrix4fv = MockUniformGL::UniformMatrix4fv;
+
+	//the sources are read and hashed as usual, the mock ignores them; the program cache is never initialised here
+	Shader shader("shaders/vertex.glsl", "shaders/lightSourceFragmentShader.glsl");
+
+	std::vector<UniformId> dirLightIds, lightIds, matrixIds;
+	for (const char* name : dirLightFields)
+		dirLightIds.push_back(UniformName(name));
+	for (int i = 0; i < lightCount; i++)
+		for (const char* field : lightFields)
+			lightIds.push_back(UniformName(("pointLights[" + std::to_string(i) + "]." + field).c_str()));
+	for (const char* name : matrices)
+		matrixIds.push_back(UniformName(name));
+
+	const glm::vec3 vector(0.5f);
+	const glm::mat4 matrix(1.0f);
+	const int frames = 100000;
+
+	auto run = [&](const char* label, const std::function<void()>& frame) {
+		double best = 1e30;
+		size_t queries = 0, calls = 0;
+		for (int attempt = 0; attempt < 5; attempt++) {
+			gl.locationQueries = 0;
+			gl.uniformCalls = 0;
+			auto start = clock::now();
+			for (int f = 0; f < frames; f++)
+				frame();
+			best = std::min(best, ms(start, clock::now()));
+			queries = gl.locationQueries;
+			calls = gl.uniformCalls;
+		}
+		std::cout << label << std::setw(6) << (double)queries / frames << " glGetUniformLocation " << std::setw(6) << (double)calls / frames
+			<< " glUniform*  " << std::setw(8) << best * 1e6 / frames << " ns/frame" << std::endl;
+	};
+
+	std::cout << std::fixed << std::setprecision(1) << gl.names.size() << " uniforms a frame, " << frames << " frames" << std::endl;
+
+	//before the table: the name built, then asked of the driver on every call
+	run("driver lookup  ", [&]() {
+		auto location = [&shader](const std::string& name) { return glGetUniformLocation(shader.ID, name.c_str()); };
+		glUniform3fv(location("viewPos"), 1, &vector[0]);
+		for (const char* name : dirLightFields)
+			glUniform3f(location(name), vector.x, vector.y, vector.z);
+		for (int i = 0; i < lightCount; i++) {
+			std::string base = "pointLights[" + std::to_string(i) + "]";
+			for (int field = 0; field < 4; field++)
+				glUniform3fv(location(base + "." + lightFields[field]), 1, &vector[0]);
+			for (int field = 4; field < 7; field++)
+				glUniform1f(location(base + "." + lightFields[field]), 1.0f);
+		}
+		for (const char* name : matrices)
+			glUniformMatrix4fv(location(name), 1, GL_FALSE, &matrix[0][0]);
+	});
+
+	run("string setters ", [&]() {
+		shader.setVec3("viewPos", vector);
+		for (const char* name : dirLightFields)
+			shader.setVec3(name, vector.x, vector.y, vector.z);
+		for (int i = 0; i < lightCount; i++) {
+			std::string base = "pointLights[" + std::to_string(i) + "]";
+			for (int field = 0; field < 4; field++)
+				shader.setVec3(base + "." + lightFields[field], vector);
+			for (int field = 4; field < 7; field++)
+				shader.setFloat(base + "." + lightFields[field], 1.0f);
+		}
+		for (const char* name : matrices)
+			shader.setMat4(name, matrix);
+	});
+
+	run("id setters     ", [&]() {
+		shader.setVec3(U_VIEW_POS, vector);
+		for (UniformId id : dirLightIds)
+			shader.setVec3(id, vector.x, vector.y, vector.z);
+		for (int i = 0; i < lightCount; i++) {
+			for (int field = 0; field < 4; field++)
+				shader.setVec3(lightIds[i * 7 + field], vector);
+			for (int field = 4; field < 7; field++)
+				shader.setFloat(lightIds[i * 7 + field], 1.0f);
+		}
+		for (UniformId id : matrixIds)
+			shader.setMat4(id, matrix);
+	});
+
+	std::tie(glad_glCreateProgram, glad_glDeleteProgram, glad_glCreateShader, glad_glDeleteShader, glad_glShaderSource,
+		glad_glCompileShader, glad_glAttachShader, glad_glLinkProgram, glad_glGetShaderiv, glad_glGetProgramiv, glad_glGetActiveUniform,
+		glad_glGetUniformLocation, glad_glUniform1i, glad_glUniform1f, glad_glUniform3f, glad_glUniform3fv, glad_glUniformMatrix4fv) = saved;
+	return 0;
+}
+
+//debug functions
+
+void AddDebugLine(glm::vec3 from, glm::vec3 to, glm::vec3 color) {
+	debugDraw.Line(from, to, color);
+}
+
+void AddDebugBox(const AABB& box, glm::vec3 color) {
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+	//corners differing in exactly one bit share an edge
+	for (int i = 0; i < 8; i++) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (!(i & bit))
+				AddDebugLine(corners[i], corners[i | bit], color);
+		}
+	}
+}
+
+void InitDebugLines(GLADloadproc loader) {
+	debugDraw.Init(loader);
+}
+
+void RenderDebugLines(Shader& debugShader, glm::mat4 view, glm::mat4 projection) {
+	PROFILE_SCOPE("RenderDebugLines");
+	GPU_PROFILE_SCOPE("Debug lines");
+	if (debugDraw.Pending() == 0) return;
+
+	debugShader.use();
+	debugShader.setMat4(U_VIEW, view);
+	debugShader.setMat4(U_PROJECTION, projection);
+
+	//draws the lines added since the last call, they were written straight into the frame's ring segment
+	frameStats.bytesUploaded += debugDraw.Flush();
+	frameStats.drawCalls++;
+
+	GLState::Get().UseProgram(0);
 }
\ No newline at end of file
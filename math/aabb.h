@@ -0,0 +1,100 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+#include <algorithm>
+
+//per component min/max, glm 0.9.8 routes the vector versions through a function pointer that doesn't inline
+inline glm::vec3 MinPerAxis(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+
+inline glm::vec3 MaxPerAxis(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extent() const { return max - min; }
+
+	float SurfaceArea() const
+	{
+		glm::vec3 e = max - min;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	bool Contains(const AABB& other) const
+	{
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+
+	bool Overlaps(const AABB& other) const
+	{
+		return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+	}
+
+	AABB Expanded(float margin) const
+	{
+		return { min - glm::vec3(margin), max + glm::vec3(margin) };
+	}
+};
+
+inline AABB Union(const AABB& a, const AABB& b)
+{
+	return { MinPerAxis(a.min, b.min), MaxPerAxis(a.max, b.max) };
+}
+
+//box around a unit cube (-0.5..0.5) after the model transform: the half extents are |M3| * 0.5
+inline AABB TransformedUnitCube(const glm::mat4& model)
+{
+	glm::vec3 center(model[3]);
+	glm::vec3 half = 0.5f * (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2])));
+	return { center - half, center + half };
+}
+
+//slab test, inverseDirection = 1 / direction (infinities are fine), enter is the distance the ray enters the box
+inline bool RayIntersectsAABB(const glm::vec3& origin, const glm::vec3& inverseDirection, const AABB& box, float maxDistance, float& enter)
+{
+	glm::vec3 t0 = (box.min - origin) * inverseDirection;
+	glm::vec3 t1 = (box.max - origin) * inverseDirection;
+	glm::vec3 tNear = MinPerAxis(t0, t1);
+	glm::vec3 tFar = MaxPerAxis(t0, t1);
+	enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	return enter <= exit;
+}
+
+inline bool SphereOverlapsAABB(const glm::vec3& center, float radius, const AABB& box)
+{
+	glm::vec3 closest = glm::clamp(center, box.min, box.max);
+	glm::vec3 d = center - closest;
+	return glm::dot(d, d) <= radius * radius;
+}
+
+enum class FrustumTest { Outside, Intersects, Inside };
+
+//per plane: the corner furthest along the normal decides outside, the nearest one decides fully inside
+inline FrustumTest ClassifyAABB(const Frustum& frustum, const AABB& box)
+{
+	FrustumTest result = FrustumTest::Inside;
+	for (const glm::vec4& plane : frustum.planes) {
+		glm::vec3 normal(plane);
+		glm::vec3 positive(normal.x >= 0.0f ? box.max.x : box.min.x, normal.y >= 0.0f ? box.max.y : box.min.y, normal.z >= 0.0f ? box.max.z : box.min.z);
+		glm::vec3 negative(normal.x >= 0.0f ? box.min.x : box.max.x, normal.y >= 0.0f ? box.min.y : box.max.y, normal.z >= 0.0f ? box.min.z : box.max.z);
+		if (glm::dot(normal, positive) + plane.w < 0.0f)
+			return FrustumTest::Outside;
+		if (glm::dot(normal, negative) + plane.w < 0.0f)
+			result = FrustumTest::Intersects;
+	}
+	return result;
+}
+
+#endif
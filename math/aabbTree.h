@@ -0,0 +1,557 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "frustum.h"
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+//dynamic AABB tree (Box2D style), one leaf per object
+//leaves hold a fattened box so small movements don't touch the tree at all,
+//Build makes the whole tree at once with a binned SAH split, Insert picks the sibling with the SAH descent cost
+//and rebalances with AVL rotations on the way up
+//moving objects either reinsert (MoveProxy, topology adapts) or update the leaf in place and Refit later (topology kept)
+//queries share a scratch stack, so they are not reentrant
+class AABBTree
+{
+public:
+	enum { NULL_NODE = -1 };
+
+	//fattening applied to leaf boxes
+	float Margin = 0.1f;
+
+	void Clear()
+	{
+		nodes.clear();
+		root = NULL_NODE;
+		freeList = NULL_NODE;
+		proxyCount = 0;
+	}
+
+	//replaces the tree with one leaf per box, proxies[i] is the proxy of boxes[i] with userData[i]
+	void Build(const std::vector<AABB>& boxes, const std::vector<uint32_t>& userData, std::vector<int>& proxies)
+	{
+		Clear();
+		nodes.reserve(boxes.size() * 2);
+		proxies.resize(boxes.size());
+
+		std::vector<BuildItem> items(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++) {
+			int leaf = allocateNode();
+			nodes[leaf].box = boxes[i].Expanded(Margin);
+			nodes[leaf].userData = userData[i];
+			nodes[leaf].height = 0;
+			proxies[i] = leaf;
+			items[i] = { nodes[leaf].box, nodes[leaf].box.Center(), leaf };
+		}
+		proxyCount = (int)boxes.size();
+
+		if (!items.empty()) {
+			root = buildRange(items, 0, items.size());
+			nodes[root].parent = NULL_NODE;
+		}
+	}
+
+	int CreateProxy(const AABB& box, uint32_t userData)
+	{
+		int leaf = allocateNode();
+		nodes[leaf].box = box.Expanded(Margin);
+		nodes[leaf].userData = userData;
+		nodes[leaf].height = 0;
+		insertLeaf(leaf);
+		proxyCount++;
+		return leaf;
+	}
+
+	void DestroyProxy(int proxy)
+	{
+		removeLeaf(proxy);
+		freeNode(proxy);
+		proxyCount--;
+	}
+
+	//reinserts the proxy if the box left its fat box, returns whether the tree changed
+	bool MoveProxy(int proxy, const AABB& box)
+	{
+		if (nodes[proxy].box.Contains(box))
+			return false;
+
+		removeLeaf(proxy);
+		nodes[proxy].box = box.Expanded(Margin);
+		insertLeaf(proxy);
+		return true;
+	}
+
+	//updates the leaf only, the ancestors are fixed up by the next Refit
+	void SetProxyBox(int proxy, const AABB& box)
+	{
+		nodes[proxy].box = box.Expanded(Margin);
+	}
+
+	//recomputes every internal box from its children, children before parents
+	void Refit()
+	{
+		if (root == NULL_NODE)
+			return;
+
+		scratch.clear();
+		scratch.push_back(root);
+		for (size_t i = 0; i < scratch.size(); i++) {
+			const Node& node = nodes[scratch[i]];
+			if (!node.IsLeaf()) {
+				scratch.push_back(node.child1);
+				scratch.push_back(node.child2);
+			}
+		}
+		for (size_t i = scratch.size(); i-- > 0;) {
+			Node& node = nodes[scratch[i]];
+			if (!node.IsLeaf())
+				node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+		}
+	}
+
+	void SetProxyUserData(int proxy, uint32_t userData) { nodes[proxy].userData = userData; }
+	uint32_t UserData(int proxy) const { return nodes[proxy].userData; }
+	const AABB& FatBox(int proxy) const { return nodes[proxy].box; }
+	int ProxyCount() const { return proxyCount; }
+	int Height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+	//calls visit(userData) for every leaf whose box touches the frustum, subtrees fully inside skip the plane tests
+	template<typename Visit>
+	void QueryFrustum(const Frustum& frustum, Visit visit) const
+	{
+		if (root == NULL_NODE)
+			return;
+
+		scratch.clear();
+		scratch.push_back(root);
+		while (!scratch.empty()) {
+			int index = scratch.back();
+			scratch.pop_back();
+			const Node& node = nodes[index];
+
+			FrustumTest test = ClassifyAABB(frustum, node.box);
+			if (test == FrustumTest::Outside)
+				continue;
+			if (test == FrustumTest::Inside) {
+				visitAll(index, visit);
+				continue;
+			}
+
+			if (node.IsLeaf()) {
+				visit(node.userData);
+			}
+			else {
+				scratch.push_back(node.child2);
+				scratch.push_back(node.child1);
+			}
+		}
+	}
+
+	template<typename Visit>
+	void QuerySphere(const glm::vec3& center, float radius, Visit visit) const
+	{
+		if (root == NULL_NODE)
+			return;
+
+		scratch.clear();
+		scratch.push_back(root);
+		while (!scratch.empty()) {
+			const Node& node = nodes[scratch.back()];
+			scratch.pop_back();
+			if (!SphereOverlapsAABB(center, radius, node.box))
+				continue;
+
+			if (node.IsLeaf()) {
+				visit(node.userData);
+			}
+			else {
+				scratch.push_back(node.child2);
+				scratch.push_back(node.child1);
+			}
+		}
+	}
+
+	//closest hit along the ray within maxDistance
+	//hitTest(userData, maxDistance, distance&) runs the exact test for a leaf the ray enters, returns true on a hit closer than maxDistance
+	template<typename HitTest>
+	bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitTest hitTest, uint32_t& hitUserData, float& hitDistance) const
+	{
+		if (root == NULL_NODE)
+			return false;
+
+		glm::vec3 inverseDirection = 1.0f / direction;
+		bool hit = false;
+		float closest = maxDistance;
+
+		scratch.clear();
+		scratch.push_back(root);
+		while (!scratch.empty()) {
+			const Node& node = nodes[scratch.back()];
+			scratch.pop_back();
+
+			float enter;
+			if (!RayIntersectsAABB(origin, inverseDirection, node.box, closest, enter))
+				continue;
+
+			if (node.IsLeaf()) {
+				float distance;
+				if (hitTest(node.userData, closest, distance) && distance < closest) {
+					closest = distance;
+					hitUserData = node.userData;
+					hit = true;
+				}
+				continue;
+			}
+
+			//nearer child on top so it is tested first and shrinks the range for the other
+			float enter1, enter2;
+			bool hit1 = RayIntersectsAABB(origin, inverseDirection, nodes[node.child1].box, closest, enter1);
+			bool hit2 = RayIntersectsAABB(origin, inverseDirection, nodes[node.child2].box, closest, enter2);
+			if (hit1 && hit2) {
+				bool firstNearer = enter1 <= enter2;
+				scratch.push_back(firstNearer ? node.child2 : node.child1);
+				scratch.push_back(firstNearer ? node.child1 : node.child2);
+			}
+			else if (hit1) {
+				scratch.push_back(node.child1);
+			}
+			else if (hit2) {
+				scratch.push_back(node.child2);
+			}
+		}
+
+		hitDistance = closest;
+		return hit;
+	}
+
+private:
+	struct Node {
+		AABB box;
+		uint32_t userData = 0;
+		int parent = NULL_NODE;		//next free node while on the free list
+		int child1 = NULL_NODE;
+		int child2 = NULL_NODE;
+		int height = -1;			//leaf 0, free -1
+
+		bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	//box copied in so the binning passes stream through one array
+	struct BuildItem {
+		AABB box;
+		glm::vec3 centroid;
+		int node;
+	};
+
+	static const int SAH_BINS = 16;
+	static const size_t SAH_MIN_ITEMS = 8;
+
+	std::vector<Node> nodes;
+	int root = NULL_NODE;
+	int freeList = NULL_NODE;
+	int proxyCount = 0;
+	mutable std::vector<int> scratch;
+	mutable std::vector<int> subtreeScratch;
+
+	int allocateNode()
+	{
+		int index;
+		if (freeList != NULL_NODE) {
+			index = freeList;
+			freeList = nodes[index].parent;
+		}
+		else {
+			index = (int)nodes.size();
+			nodes.emplace_back();
+		}
+		nodes[index] = Node();
+		return index;
+	}
+
+	void freeNode(int index)
+	{
+		nodes[index].parent = freeList;
+		nodes[index].height = -1;
+		freeList = index;
+	}
+
+	//every leaf under start, on its own stack since the caller's scratch is still in use
+	template<typename Visit>
+	void visitAll(int start, Visit& visit) const
+	{
+		subtreeScratch.clear();
+		subtreeScratch.push_back(start);
+		while (!subtreeScratch.empty()) {
+			const Node& node = nodes[subtreeScratch.back()];
+			subtreeScratch.pop_back();
+			if (node.IsLeaf()) {
+				visit(node.userData);
+			}
+			else {
+				subtreeScratch.push_back(node.child2);
+				subtreeScratch.push_back(node.child1);
+			}
+		}
+	}
+
+	//binned SAH over the centroids of items[begin, end), returns the subtree root
+	int buildRange(std::vector<BuildItem>& items, size_t begin, size_t end)
+	{
+		if (end - begin == 1)
+			return items[begin].node;
+
+		AABB centroidBounds = { items[begin].centroid, items[begin].centroid };
+		for (size_t i = begin + 1; i < end; i++) {
+			centroidBounds.min = MinPerAxis(centroidBounds.min, items[i].centroid);
+			centroidBounds.max = MaxPerAxis(centroidBounds.max, items[i].centroid);
+		}
+
+		size_t middle = begin;
+		glm::vec3 extent = centroidBounds.Extent();
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+		//binning costs the same for 3 items as for 3000, small ranges just split at the median of the longest axis
+		if (extent[axis] > 0.0f && end - begin > SAH_MIN_ITEMS) {
+			//all three axes binned in one pass over the items
+			glm::vec3 scale;
+			for (int a = 0; a < 3; a++)
+				scale[a] = extent[a] > 0.0f ? SAH_BINS / extent[a] : 0.0f;
+
+			const float inf = std::numeric_limits<float>::max();
+			const AABB empty = { glm::vec3(inf), glm::vec3(-inf) };
+			int counts[3][SAH_BINS] = {};
+			AABB bins[3][SAH_BINS];
+			for (int a = 0; a < 3; a++)
+				std::fill(bins[a], bins[a] + SAH_BINS, empty);
+
+			for (size_t i = begin; i < end; i++) {
+				const BuildItem& item = items[i];
+				for (int a = 0; a < 3; a++) {
+					int bin = std::min(SAH_BINS - 1, (int)((item.centroid[a] - centroidBounds.min[a]) * scale[a]));
+					counts[a][bin]++;
+					bins[a][bin] = Union(bins[a][bin], item.box);
+				}
+			}
+
+			float bestCost = std::numeric_limits<float>::max();
+			int bestAxis = axis, bestSplit = -1;
+			for (int a = 0; a < 3; a++) {
+				if (extent[a] <= 0.0f) continue;
+
+				//sweep from the right to get the area/count to the right of each split
+				float rightArea[SAH_BINS];
+				int rightCount[SAH_BINS];
+				AABB right = empty;
+				int count = 0;
+				for (int b = SAH_BINS - 1; b > 0; b--) {
+					right = Union(right, bins[a][b]);
+					count += counts[a][b];
+					rightCount[b] = count;
+					rightArea[b] = count ? right.SurfaceArea() : 0.0f;
+				}
+
+				AABB left = empty;
+				count = 0;
+				for (int b = 0; b < SAH_BINS - 1; b++) {
+					left = Union(left, bins[a][b]);
+					count += counts[a][b];
+					if (count == 0 || rightCount[b + 1] == 0) continue;
+					float cost = count * left.SurfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = a;
+						bestSplit = b;
+					}
+				}
+			}
+
+			if (bestSplit >= 0) {
+				float axisScale = scale[bestAxis];
+				float minimum = centroidBounds.min[bestAxis];
+				middle = std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem& item) {
+					return std::min(SAH_BINS - 1, (int)((item.centroid[bestAxis] - minimum) * axisScale)) <= bestSplit;
+				}) - items.begin();
+			}
+			axis = bestAxis;
+		}
+
+		//all centroids in one spot or no useful split, halve by count
+		if (middle == begin || middle == end) {
+			middle = begin + (end - begin) / 2;
+			std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end,
+				[axis](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+		}
+
+		int child1 = buildRange(items, begin, middle);
+		int child2 = buildRange(items, middle, end);
+
+		int index = allocateNode();
+		Node& node = nodes[index];
+		node.child1 = child1;
+		node.child2 = child2;
+		node.box = Union(nodes[child1].box, nodes[child2].box);
+		node.height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[child1].parent = index;
+		nodes[child2].parent = index;
+		return index;
+	}
+
+	void insertLeaf(int leaf)
+	{
+		if (root == NULL_NODE) {
+			root = leaf;
+			nodes[root].parent = NULL_NODE;
+			return;
+		}
+
+		//descend towards the cheapest sibling: creating a parent here costs 2 * area(here + leaf),
+		//going down adds the growth of every ancestor (inheritance) plus the cost in the child
+		AABB leafBox = nodes[leaf].box;
+		int index = root;
+		while (!nodes[index].IsLeaf()) {
+			const Node& node = nodes[index];
+			float area = node.box.SurfaceArea();
+			float combinedArea = Union(node.box, leafBox).SurfaceArea();
+
+			float cost = 2.0f * combinedArea;
+			float inheritance = 2.0f * (combinedArea - area);
+
+			auto descendCost = [&](int child) {
+				float childArea = Union(leafBox, nodes[child].box).SurfaceArea();
+				return nodes[child].IsLeaf() ? childArea + inheritance : childArea - nodes[child].box.SurfaceArea() + inheritance;
+			};
+			float cost1 = descendCost(node.child1);
+			float cost2 = descendCost(node.child2);
+
+			if (cost < cost1 && cost < cost2)
+				break;
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		int sibling = index;
+		int oldParent = nodes[sibling].parent;
+		int newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].box = Union(leafBox, nodes[sibling].box);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE)
+			root = newParent;
+		else if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+
+		fixUpwards(nodes[leaf].parent);
+	}
+
+	void removeLeaf(int leaf)
+	{
+		if (leaf == root) {
+			root = NULL_NODE;
+			return;
+		}
+
+		int parent = nodes[leaf].parent;
+		int grandParent = nodes[parent].parent;
+		int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		if (grandParent == NULL_NODE) {
+			root = sibling;
+			nodes[sibling].parent = NULL_NODE;
+			freeNode(parent);
+			return;
+		}
+
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		fixUpwards(grandParent);
+	}
+
+	//rebalance and refit from index up to the root
+	void fixUpwards(int index)
+	{
+		while (index != NULL_NODE) {
+			index = balance(index);
+
+			Node& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+			node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+
+			index = node.parent;
+		}
+	}
+
+	//AVL style: if one child of A is more than one level taller, that child becomes the subtree root,
+	//A takes its shorter grandchild, returns the new subtree root
+	int balance(int iA)
+	{
+		Node& A = nodes[iA];
+		if (A.IsLeaf() || A.height < 2)
+			return iA;
+
+		int iB = A.child1;
+		int iC = A.child2;
+		int diff = nodes[iC].height - nodes[iB].height;
+
+		if (diff > 1)
+			return rotateUp(iA, iC, iB, false);
+		if (diff < -1)
+			return rotateUp(iA, iB, iC, true);
+		return iA;
+	}
+
+	//lifts child iUp of iA above it, iOther stays under iA, upIsFirst says which slot of A iUp was in
+	int rotateUp(int iA, int iUp, int iOther, bool upIsFirst)
+	{
+		Node& A = nodes[iA];
+		Node& up = nodes[iUp];
+		int iF = up.child1;
+		int iG = up.child2;
+
+		up.child1 = iA;
+		up.parent = A.parent;
+		A.parent = iUp;
+
+		if (up.parent == NULL_NODE)
+			root = iUp;
+		else if (nodes[up.parent].child1 == iA)
+			nodes[up.parent].child1 = iUp;
+		else
+			nodes[up.parent].child2 = iUp;
+
+		//the taller grandchild stays with up, the shorter one moves under A in the slot up came from
+		int iKeep = nodes[iF].height > nodes[iG].height ? iF : iG;
+		int iMove = iKeep == iF ? iG : iF;
+
+		up.child2 = iKeep;
+		if (upIsFirst)
+			A.child1 = iMove;
+		else
+			A.child2 = iMove;
+		nodes[iMove].parent = iA;
+
+		A.box = Union(nodes[iOther].box, nodes[iMove].box);
+		A.height = 1 + std::max(nodes[iOther].height, nodes[iMove].height);
+		up.box = Union(A.box, nodes[iKeep].box);
+		up.height = 1 + std::max(A.height, nodes[iKeep].height);
+		return iUp;
+	}
+};
+
+#endif
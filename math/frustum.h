@@ -0,0 +1,44 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+//six planes (xyz = normal pointing inwards, w = distance), a point p is inside when dot(n, p) + w >= 0 for all of them
+struct Frustum {
+	enum { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+	glm::vec4 planes[PLANE_COUNT];
+};
+
+//Gribb/Hartmann: the planes are sums and differences of the rows of projection * view,
+//normalised so the plane distance is a real distance and can be compared against a radius
+inline Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	//glm is column major, m[column][row]
+	auto row = [&viewProjection](int r) {
+		return glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	};
+	glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+	Frustum frustum;
+	frustum.planes[Frustum::LEFT] = r3 + r0;
+	frustum.planes[Frustum::RIGHT] = r3 - r0;
+	frustum.planes[Frustum::BOTTOM] = r3 + r1;
+	frustum.planes[Frustum::TOP] = r3 - r1;
+	frustum.planes[Frustum::NEAR_PLANE] = r3 + r2;
+	frustum.planes[Frustum::FAR_PLANE] = r3 - r2;
+
+	for (glm::vec4& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return frustum;
+}
+
+inline bool SphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius)
+{
+	for (const glm::vec4& plane : frustum.planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+#endif
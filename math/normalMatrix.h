@@ -0,0 +1,109 @@
+#ifndef NORMAL_MATRIX_H
+#define NORMAL_MATRIX_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMAL_MATRIX_SSE 1
+#include <xmmintrin.h>
+#endif
+
+//normal matrix = inverse-transpose of the upper 3x3 of the model matrix
+//the inverse-transpose of a 3x3 with columns c0,c1,c2 is [c1 x c2, c2 x c0, c0 x c1] / det,
+//three cross products and a dot, no full 4x4 inverse
+
+//rotation + translation + uniform scale: the inverse-transpose is the matrix itself over scale^2
+inline glm::mat3 RigidNormalMatrix(const glm::mat4& model)
+{
+	glm::vec3 c0(model[0]);
+	float invScale2 = 1.0f / glm::dot(c0, c0);
+	return glm::mat3(glm::vec3(model[0]) * invScale2, glm::vec3(model[1]) * invScale2, glm::vec3(model[2]) * invScale2);
+}
+
+inline bool IsRigidTransform(const glm::mat4& model, float tolerance = 1e-4f)
+{
+	glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+	float l0 = glm::dot(c0, c0);
+	float eps = tolerance * l0;
+	return std::abs(glm::dot(c1, c1) - l0) <= eps && std::abs(glm::dot(c2, c2) - l0) <= eps
+		&& std::abs(glm::dot(c0, c1)) <= eps && std::abs(glm::dot(c0, c2)) <= eps && std::abs(glm::dot(c1, c2)) <= eps;
+}
+
+inline glm::mat3 GeneralNormalMatrix(const glm::mat4& model)
+{
+	glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+	glm::vec3 r0 = glm::cross(c1, c2);
+	glm::vec3 r1 = glm::cross(c2, c0);
+	glm::vec3 r2 = glm::cross(c0, c1);
+	float invDet = 1.0f / glm::dot(c0, r0);
+	return glm::mat3(r0 * invDet, r1 * invDet, r2 * invDet);
+}
+
+inline glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+	return IsRigidTransform(model) ? RigidNormalMatrix(model) : GeneralNormalMatrix(model);
+}
+
+#ifdef NORMAL_MATRIX_SSE
+namespace detail {
+	//(a.yzx * b.zxy - a.zxy * b.yzx), w lane ends up 0
+	inline __m128 Cross(__m128 a, __m128 b)
+	{
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	inline float Dot3(__m128 a, __m128 b)
+	{
+		__m128 m = _mm_mul_ps(a, b);
+		__m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+		return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+	}
+}
+#endif
+
+//batch version for instance buffers, branch free general path using 4-wide cross products
+//callers that only build rotation/translation/uniform scale pass allRigid and skip the inverse
+inline void NormalMatrices(const glm::mat4* models, glm::mat3* out, size_t count, bool allRigid = false)
+{
+	if (allRigid) {
+		for (size_t i = 0; i < count; i++)
+			out[i] = RigidNormalMatrix(models[i]);
+		return;
+	}
+
+#ifdef NORMAL_MATRIX_SSE
+	for (size_t i = 0; i < count; i++) {
+		const float* m = &models[i][0][0];
+		__m128 c0 = _mm_loadu_ps(m + 0);
+		__m128 c1 = _mm_loadu_ps(m + 4);
+		__m128 c2 = _mm_loadu_ps(m + 8);
+
+		__m128 r0 = detail::Cross(c1, c2);
+		__m128 r1 = detail::Cross(c2, c0);
+		__m128 r2 = detail::Cross(c0, c1);
+		__m128 invDet = _mm_set1_ps(1.0f / detail::Dot3(c0, r0));
+
+		float columns[12];
+		_mm_storeu_ps(columns + 0, _mm_mul_ps(r0, invDet));
+		_mm_storeu_ps(columns + 4, _mm_mul_ps(r1, invDet));
+		_mm_storeu_ps(columns + 8, _mm_mul_ps(r2, invDet));
+
+		float* n = &out[i][0][0];
+		n[0] = columns[0]; n[1] = columns[1]; n[2] = columns[2];
+		n[3] = columns[4]; n[4] = columns[5]; n[5] = columns[6];
+		n[6] = columns[8]; n[7] = columns[9]; n[8] = columns[10];
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		out[i] = GeneralNormalMatrix(models[i]);
+#endif
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SPHERE_CULLING_H
+#define SPHERE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPHERE_CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+//8 wide only when the compiler may emit AVX (/arch:AVX, -mavx), otherwise the 4 wide kernel runs
+#if defined(__AVX__)
+#define SPHERE_CULLING_AVX 1
+#include <immintrin.h>
+#endif
+
+//bounding spheres stored SoA, so a kernel loads 4 (or 8) centres per component in one go
+struct BoundingSpheres {
+	std::vector<float> x, y, z, radius;
+
+	void Clear()
+	{
+		x.clear(); y.clear(); z.clear(); radius.clear();
+	}
+
+	void Reserve(size_t count)
+	{
+		x.reserve(count); y.reserve(count); z.reserve(count); radius.reserve(count);
+	}
+
+	void Add(const glm::vec3& center, float r)
+	{
+		x.push_back(center.x);
+		y.push_back(center.y);
+		z.push_back(center.z);
+		radius.push_back(r);
+	}
+
+	size_t Size() const { return x.size(); }
+};
+
+//reference kernel, also handles the tail the wide kernels leave over
+inline size_t CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, size_t first, uint32_t* visible)
+{
+	size_t count = 0;
+	for (size_t i = first; i < spheres.Size(); i++) {
+		if (SphereInFrustum(frustum, glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]))
+			visible[count++] = (uint32_t)i;
+	}
+	return count;
+}
+
+//writes the indices of the spheres that touch the frustum to visible (in order) and returns how many there are
+//per batch: 6 planes x 3 multiply-adds and a compare, then the survivors are compacted from the movemask bits
+//without branches (every lane is written, the count only advances for visible ones)
+inline size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible)
+{
+	const size_t total = spheres.Size();
+	visible.resize(total);
+	uint32_t* out = visible.data();
+	size_t count = 0;
+	size_t i = 0;
+
+#if defined(SPHERE_CULLING_AVX)
+	__m256 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + 8 <= total; i += 8) {
+		__m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p])),
+				_mm256_add_ps(_mm256_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++) {
+			out[count] = (uint32_t)(i + lane);
+			count += (mask >> lane) & 1;
+		}
+	}
+#elif defined(SPHERE_CULLING_SSE)
+	__m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + 4 <= total; i += 4) {
+		__m128 x = _mm_loadu_ps(&spheres.x[i]);
+		__m128 y = _mm_loadu_ps(&spheres.y[i]);
+		__m128 z = _mm_loadu_ps(&spheres.z[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++) {
+			out[count] = (uint32_t)(i + lane);
+			count += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	count += CullSpheresScalar(frustum, spheres, i, out + count);
+	visible.resize(count);
+	return count;
+}
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "../core/jobSystem.h"
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_HIERARCHY_SSE 1
+#include <xmmintrin.h>
+#endif
+
+//scene transforms: local translation / rotation / scale per node stored SoA, world matrices in one array that
+//consumers index by node (it only moves when nodes are added)
+//nodes are kept parent before child, so one forward pass sees every parent's world matrix before its children
+//setters only flag the node; Update recomputes from the first flagged node on, a node is redone when it or its parent
+//changed, so whole subtrees follow and everything else is skipped; with nothing flagged Update returns straight away
+//the pass is split into segments whose parents all lie in earlier segments, each one runs as a ParallelFor;
+//adding nodes level by level (roots, then their children, ...) keeps that to one segment per level
+class TransformHierarchy
+{
+public:
+	enum : uint32_t { NO_PARENT = 0xFFFFFFFFu };
+	enum { UPDATE_GRAIN = 4096 };
+
+	//world matrices that changed in the last Update
+	size_t ChangedCount = 0;
+
+	//parent has to be an existing node, which keeps the order parent before child
+	uint32_t Add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f), uint32_t parent = NO_PARENT)
+	{
+		uint32_t node = (uint32_t)parents.size();
+		px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+		qx.push_back(rotation.x); qy.push_back(rotation.y); qz.push_back(rotation.z); qw.push_back(rotation.w);
+		sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+		parents.push_back(parent < node ? parent : NO_PARENT);
+		world.push_back(glm::mat4(1.0f));
+		dirty.push_back(1);
+		changed.push_back(0);
+
+		if (segments.empty() || (parents.back() != NO_PARENT && parents.back() >= segments.back()))
+			segments.push_back(node);
+		firstDirty = std::min(firstDirty, (size_t)node);
+		return node;
+	}
+
+	void Reserve(size_t count)
+	{
+		px.reserve(count); py.reserve(count); pz.reserve(count);
+		qx.reserve(count); qy.reserve(count); qz.reserve(count); qw.reserve(count);
+		sx.reserve(count); sy.reserve(count); sz.reserve(count);
+		parents.reserve(count);
+		world.reserve(count);
+		dirty.reserve(count);
+		changed.reserve(count);
+	}
+
+	//drops the nodes from count on; children always come after their parents, so nothing is left dangling
+	void Truncate(size_t count)
+	{
+		if (count >= parents.size())
+			return;
+		px.resize(count); py.resize(count); pz.resize(count);
+		qx.resize(count); qy.resize(count); qz.resize(count); qw.resize(count);
+		sx.resize(count); sy.resize(count); sz.resize(count);
+		parents.resize(count);
+		world.resize(count);
+		dirty.resize(count);
+		changed.resize(count);
+		while (!segments.empty() && segments.back() >= count)
+			segments.pop_back();
+		changedFrom = std::min(changedFrom, count);
+		if (firstDirty >= count)
+			firstDirty = NOTHING_DIRTY;
+	}
+
+	void Clear()
+	{
+		Truncate(0);
+		ChangedCount = 0;
+	}
+
+	size_t Size() const { return parents.size(); }
+
+	glm::vec3 Position(uint32_t node) const { return glm::vec3(px[node], py[node], pz[node]); }
+	glm::quat Rotation(uint32_t node) const { return glm::quat(qw[node], qx[node], qy[node], qz[node]); }
+	glm::vec3 Scale(uint32_t node) const { return glm::vec3(sx[node], sy[node], sz[node]); }
+	uint32_t Parent(uint32_t node) const { return parents[node]; }
+
+	void SetPosition(uint32_t node, const glm::vec3& position)
+	{
+		px[node] = position.x; py[node] = position.y; pz[node] = position.z;
+		markDirty(node);
+	}
+
+	void SetRotation(uint32_t node, const glm::quat& rotation)
+	{
+		qx[node] = rotation.x; qy[node] = rotation.y; qz[node] = rotation.z; qw[node] = rotation.w;
+		markDirty(node);
+	}
+
+	void SetScale(uint32_t node, const glm::vec3& scale)
+	{
+		sx[node] = scale.x; sy[node] = scale.y; sz[node] = scale.z;
+		markDirty(node);
+	}
+
+	//every node recomputed on the next Update
+	void Invalidate()
+	{
+		std::fill(dirty.begin(), dirty.end(), (uint8_t)1);
+		if (!parents.empty())
+			firstDirty = 0;
+	}
+
+	//valid until nodes are added or removed
+	const glm::mat4* World() const { return world.data(); }
+	const glm::mat4& World(uint32_t node) const { return world[node]; }
+
+	//whether the node's world matrix changed in the last Update
+	bool Changed(uint32_t node) const { return changed[node] != 0; }
+
+	size_t Update()
+	{
+		//only the range the previous update touched can still be flagged
+		std::fill(changed.begin() + std::min(changedFrom, changed.size()), changed.end(), (uint8_t)0);
+		ChangedCount = 0;
+		changedFrom = parents.size();
+		if (firstDirty >= parents.size())
+			return 0;
+
+		changedFrom = firstDirty;
+		std::atomic<size_t> changedTotal{ 0 };
+		for (size_t segment = 0; segment < segments.size(); segment++) {
+			size_t end = segment + 1 < segments.size() ? segments[segment + 1] : parents.size();
+			size_t begin = std::max((size_t)segments[segment], firstDirty);
+			if (begin >= end)
+				continue;
+			JobSystem::Get().ParallelFor(end - begin, UPDATE_GRAIN, [this, begin, &changedTotal](size_t first, size_t last) {
+				changedTotal.fetch_add(updateRange(begin + first, begin + last), std::memory_order_relaxed);
+			});
+		}
+		firstDirty = NOTHING_DIRTY;
+		ChangedCount = changedTotal.load();
+		return ChangedCount;
+	}
+
+	//translate * rotate * scale, what Update composes with the parent (the reference the SIMD path is checked against)
+	static glm::mat4 LocalMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		glm::mat4 local = glm::mat4_cast(rotation);
+		local[0] *= scale.x;
+		local[1] *= scale.y;
+		local[2] *= scale.z;
+		local[3] = glm::vec4(position, 1.0f);
+		return local;
+	}
+
+private:
+	enum : size_t { NOTHING_DIRTY = ~(size_t)0 };
+
+	std::vector<float> px, py, pz;
+	std::vector<float> qx, qy, qz, qw;
+	std::vector<float> sx, sy, sz;
+	std::vector<uint32_t> parents;
+	std::vector<glm::mat4> world;
+	std::vector<uint8_t> dirty;			//local values changed since the last Update
+	std::vector<uint8_t> changed;		//world matrix changed in the last Update
+	std::vector<uint32_t> segments;		//first node of each segment
+	size_t firstDirty = NOTHING_DIRTY;
+	size_t changedFrom = 0;
+
+	void markDirty(uint32_t node)
+	{
+		dirty[node] = 1;
+		firstDirty = std::min(firstDirty, (size_t)node);
+	}
+
+	bool needsUpdate(size_t node) const
+	{
+		uint32_t parent = parents[node];
+		return dirty[node] || (parent != NO_PARENT && changed[parent]);
+	}
+
+	void updateScalar(size_t node)
+	{
+		glm::mat4 local = LocalMatrix(Position((uint32_t)node), Rotation((uint32_t)node), Scale((uint32_t)node));
+		uint32_t parent = parents[node];
+		world[node] = parent == NO_PARENT ? local : world[parent] * local;
+	}
+
+	//nodes of one segment, returns how many were recomputed
+	size_t updateRange(size_t begin, size_t end)
+	{
+		size_t count = 0;
+		size_t node = begin;
+
+#ifdef TRANSFORM_HIERARCHY_SSE
+		//4 nodes at a time: local matrices built SoA (one lane per node), transposed to columns, then each node that
+		//needs it is multiplied with its parent's world matrix column by column
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		for (; node + 4 <= end; node += 4) {
+			int mask = 0;
+			for (int lane = 0; lane < 4; lane++)
+				if (needsUpdate(node + lane))
+					mask |= 1 << lane;
+			if (!mask)
+				continue;
+
+			__m128 x = _mm_loadu_ps(&qx[node]), y = _mm_loadu_ps(&qy[node]), z = _mm_loadu_ps(&qz[node]), w = _mm_loadu_ps(&qw[node]);
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+			__m128 scaleX = _mm_loadu_ps(&sx[node]), scaleY = _mm_loadu_ps(&sy[node]), scaleZ = _mm_loadu_ps(&sz[node]);
+
+			//column c, row r of the rotation (glm::mat4_cast), times the scale of that column
+			__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+			__m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+			__m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+			__m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+			__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+			__m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+			__m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+			__m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+			__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+			__m128 c3x = _mm_loadu_ps(&px[node]), c3y = _mm_loadu_ps(&py[node]), c3z = _mm_loadu_ps(&pz[node]);
+			__m128 c0w = _mm_setzero_ps(), c1w = _mm_setzero_ps(), c2w = _mm_setzero_ps(), c3w = one;
+
+			//after the transposes register k holds that column of node + k
+			_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+			_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+			_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+			_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+			__m128 columns[4][4] = {
+				{ c0x, c1x, c2x, c3x }, { c0y, c1y, c2y, c3y }, { c0z, c1z, c2z, c3z }, { c0w, c1w, c2w, c3w }
+			};
+
+			for (int lane = 0; lane < 4; lane++) {
+				if (!(mask & (1 << lane)))
+					continue;
+				size_t current = node + lane;
+				float* out = &world[current][0][0];
+				uint32_t parent = parents[current];
+				if (parent == NO_PARENT) {
+					for (int column = 0; column < 4; column++)
+						_mm_storeu_ps(out + column * 4, columns[lane][column]);
+				}
+				else {
+					const float* p = &world[parent][0][0];
+					__m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8), p3 = _mm_loadu_ps(p + 12);
+					for (int column = 0; column < 4; column++) {
+						__m128 l = columns[lane][column];
+						__m128 result = _mm_add_ps(
+							_mm_add_ps(_mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0))), _mm_mul_ps(p1, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)))),
+							_mm_add_ps(_mm_mul_ps(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2))), _mm_mul_ps(p3, _mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3)))));
+						_mm_storeu_ps(out + column * 4, result);
+					}
+				}
+				dirty[current] = 0;
+				changed[current] = 1;
+				count++;
+			}
+		}
+#endif
+
+		for (; node < end; node++) {
+			if (!needsUpdate(node))
+				continue;
+			updateScalar(node);
+			dirty[node] = 0;
+			changed[node] = 1;
+			count++;
+		}
+		return count;
+	}
+};
+
+#endif
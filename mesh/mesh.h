@@ -0,0 +1,95 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+
+#include "meshBuilder.h"
+#include "../renderer/glState.h"
+
+#include <vector>
+#include <cstddef>
+
+//GPU side of a MeshData: one interleaved VBO plus an element buffer
+//indices are narrowed to 16 bit whenever the vertex count allows it
+class Mesh
+{
+public:
+	unsigned int VBO = 0;
+	unsigned int EBO = 0;
+	GLsizei IndexCount = 0;
+	GLsizei VertexCount = 0;
+	GLenum IndexType = GL_UNSIGNED_INT;
+
+	void Upload(const MeshData& data)
+	{
+		if (data.vertices.size() <= 0xFFFF) {
+			std::vector<unsigned short> shortIndices(data.indices.begin(), data.indices.end());
+			UploadRaw(data.vertices.data(), data.vertices.size(), shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT);
+		}
+		else {
+			UploadRaw(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), GL_UNSIGNED_INT);
+		}
+	}
+
+	//uploads already packed vertices/indices as-is, e.g. straight out of a mapped .mesh file
+	void UploadRaw(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount, GLenum indexType)
+	{
+		if (VBO == 0) glGenBuffers(1, &VBO);
+		if (EBO == 0) glGenBuffers(1, &EBO);
+
+		VertexCount = (GLsizei)vertexCount;
+		IndexCount = (GLsizei)indexCount;
+		IndexType = indexType;
+
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+
+		//element buffer binding is VAO state, don't disturb whatever VAO is bound
+		GLState::Get().BindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	//sets up attributes 0-2 (or just the position) and the element buffer on the bound VAO
+	void AttachToBoundVAO(bool positionOnly = false) const
+	{
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+		if (positionOnly) return;
+
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+		glEnableVertexAttribArray(2);
+	}
+
+	void Draw() const
+	{
+		glDrawElements(GL_TRIANGLES, IndexCount, IndexType, 0);
+	}
+
+	void DrawInstanced(GLsizei instanceCount) const
+	{
+		glDrawElementsInstanced(GL_TRIANGLES, IndexCount, IndexType, 0, instanceCount);
+	}
+
+	//every vertex once as a point, no indices, for passes that work per vertex (debug vectors)
+	void DrawPoints(GLsizei instanceCount = 1) const
+	{
+		glDrawArraysInstanced(GL_POINTS, 0, VertexCount, instanceCount);
+	}
+
+	void Destroy()
+	{
+		GLState::Get().DeleteBuffers(1, &VBO);
+		GLState::Get().DeleteBuffers(1, &EBO);
+		VBO = EBO = 0;
+	}
+};
+
+#endif
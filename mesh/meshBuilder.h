@@ -0,0 +1,251 @@
+#ifndef MESH_BUILDER_H
+#define MESH_BUILDER_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+
+//interleaved vertex, same layout as the old 8 float cube soup (position, normal, uv)
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed");
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+struct VertexBytesHash {
+	size_t operator()(const Vertex& v) const
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	}
+};
+
+struct VertexBytesEqual {
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+//welds identical position/normal/uv tuples of a triangle soup into a compact vertex buffer + index buffer
+inline MeshData WeldVertices(const Vertex* soup, size_t vertexCount)
+{
+	MeshData mesh;
+	mesh.indices.reserve(vertexCount);
+
+	std::unordered_map<Vertex, unsigned int, VertexBytesHash, VertexBytesEqual> lookup;
+	lookup.reserve(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		auto inserted = lookup.emplace(soup[i], (unsigned int)mesh.vertices.size());
+		if (inserted.second)
+			mesh.vertices.push_back(soup[i]);
+		mesh.indices.push_back(inserted.first->second);
+	}
+	return mesh;
+}
+
+inline MeshData WeldVertices(const float* interleaved, size_t vertexCount)
+{
+	return WeldVertices(reinterpret_cast<const Vertex*>(interleaved), vertexCount);
+}
+
+//average cache miss ratio: transformed vertices per triangle with a FIFO post-transform cache
+//1.0 is a good mesh, 3.0 means no reuse at all
+inline float ComputeACMR(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = 16)
+{
+	if (indices.empty()) return 0.0f;
+
+	std::vector<int> insertedAt(vertexCount, -1 - cacheSize);
+	int misses = 0;
+	for (unsigned int index : indices) {
+		if (misses - insertedAt[index] > cacheSize) {
+			insertedAt[index] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+//Tom Forsyth's linear-speed vertex cache optimisation, reorders triangles so shared vertices stay hot
+inline void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	const int CACHE_SIZE = 32;
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	auto vertexScore = [](int cachePosition, int activeTriangles) {
+		if (activeTriangles == 0) return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				score = 0.75f;
+			}
+			else {
+				float scaler = 1.0f / (CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+			}
+		}
+		return score + 2.0f / std::sqrt((float)activeTriangles);
+	};
+
+	//vertex -> triangle adjacency in one flat array
+	std::vector<int> activeCount(vertexCount, 0);
+	for (unsigned int index : indices)
+		activeCount[index]++;
+
+	std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + activeCount[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(-1, activeCount[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	std::vector<int> cache;
+	cache.reserve(CACHE_SIZE + 3);
+	std::vector<int> nextCache;
+	nextCache.reserve(CACHE_SIZE + 3);
+
+	size_t scanCursor = 0;
+	long long bestTriangle = -1;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (bestTriangle < 0) {
+			//nothing adjacent to the cache, fall back to the best remaining triangle
+			float bestScore = -1.0f;
+			while (scanCursor < triangleCount && emitted[scanCursor])
+				scanCursor++;
+			for (size_t t = scanCursor; t < triangleCount; t++) {
+				if (!emitted[t] && triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = (long long)t;
+				}
+			}
+		}
+
+		size_t triangle = (size_t)bestTriangle;
+		emitted[triangle] = 1;
+
+		nextCache.clear();
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices[triangle * 3 + k];
+			output.push_back(v);
+
+			//drop this triangle from the vertex's active list
+			size_t begin = adjacencyStart[v];
+			size_t end = begin + activeCount[v];
+			for (size_t a = begin; a < end; a++) {
+				if (adjacency[a] == triangle) {
+					adjacency[a] = adjacency[end - 1];
+					break;
+				}
+			}
+			activeCount[v]--;
+			nextCache.push_back((int)v);
+		}
+
+		for (int v : cache)
+			if (v != (int)indices[triangle * 3] && v != (int)indices[triangle * 3 + 1] && v != (int)indices[triangle * 3 + 2])
+				nextCache.push_back(v);
+
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			int v = nextCache[i];
+			cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+			score[v] = vertexScore(cachePosition[v], activeCount[v]);
+		}
+
+		//rescore triangles touching the cache and pick the next best among them
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int v : nextCache) {
+			size_t begin = adjacencyStart[v];
+			for (size_t a = begin; a < begin + activeCount[v]; a++) {
+				unsigned int t = adjacency[a];
+				float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				triangleScore[t] = s;
+				if (s > bestScore) {
+					bestScore = s;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > CACHE_SIZE)
+			nextCache.resize(CACHE_SIZE);
+		cache.swap(nextCache);
+	}
+
+	indices.swap(output);
+}
+
+//uv sphere, used to check the index path on something larger than a cube
+inline MeshData GenerateSphere(int rings, int segments, float radius = 0.5f)
+{
+	MeshData mesh;
+	for (int r = 0; r <= rings; r++) {
+		float v = (float)r / rings;
+		float phi = v * glm::pi<float>();
+		for (int s = 0; s <= segments; s++) {
+			float u = (float)s / segments;
+			float theta = u * 2.0f * glm::pi<float>();
+			glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+			mesh.vertices.push_back({ normal * radius, normal, glm::vec2(u, 1.0f - v) });
+		}
+	}
+
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			unsigned int a = r * (segments + 1) + s;
+			unsigned int b = a + segments + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+	return mesh;
+}
+
+//scrambles triangle order, what an unoptimised exporter tends to hand us
+inline void ShuffleTriangles(std::vector<unsigned int>& indices, unsigned int seed = 1u)
+{
+	size_t triangleCount = indices.size() / 3;
+	for (size_t t = triangleCount; t > 1; t--) {
+		seed = seed * 1664525u + 1013904223u;
+		size_t other = seed % t;
+		for (int k = 0; k < 3; k++)
+			std::swap(indices[(t - 1) * 3 + k], indices[other * 3 + k]);
+	}
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "meshBuilder.h"
+#include "../core/mappedFile.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+//binary .mesh cache: a fixed header followed by the vertex and index blobs, each 64 byte aligned
+//the blobs are laid out exactly as the GPU wants them so loading is map + glBufferData
+//bump MESH_CACHE_VERSION whenever Vertex or the header changes, old files then get rebuilt
+
+const uint32_t MESH_CACHE_MAGIC = 0x4853454Du; //"MESH"
+const uint32_t MESH_CACHE_VERSION = 1;
+const uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t indexSize;			//2 or 4 bytes
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t sourceSize;		//stamp of the file the cache was built from
+	int64_t sourceModified;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 64, "MeshCacheHeader layout is part of the file format");
+
+inline uint64_t AlignMeshCacheOffset(uint64_t offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+inline bool WriteMeshCache(const std::string& path, const MeshData& mesh, const FileStamp& source)
+{
+	bool shortIndices = mesh.vertices.size() <= 0xFFFF;
+
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.indexSize = shortIndices ? 2 : 4;
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	header.vertexOffset = AlignMeshCacheOffset(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignMeshCacheOffset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+	header.sourceSize = source.size;
+	header.sourceModified = source.modified;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	static const char padding[MESH_CACHE_ALIGNMENT] = {};
+	uint64_t written = 0;
+	auto writeAt = [&](uint64_t offset, const void* bytes, uint64_t size) {
+		file.write(padding, (std::streamsize)(offset - written));
+		file.write(reinterpret_cast<const char*>(bytes), (std::streamsize)size);
+		written = offset + size;
+	};
+
+	writeAt(0, &header, sizeof(header));
+	writeAt(header.vertexOffset, mesh.vertices.data(), header.vertexCount * sizeof(Vertex));
+	if (shortIndices) {
+		std::vector<uint16_t> packed(mesh.indices.begin(), mesh.indices.end());
+		writeAt(header.indexOffset, packed.data(), packed.size() * sizeof(uint16_t));
+	}
+	else {
+		writeAt(header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	}
+
+	return (bool)file;
+}
+
+//maps a .mesh file and exposes its blobs in place, nothing is copied
+class MeshCacheFile
+{
+public:
+	//fails on a missing, truncated, foreign or out of date file; pass a null stamp to skip the staleness check
+	bool Open(const std::string& path, const FileStamp* expectedSource = nullptr)
+	{
+		if (!file.Open(path) || file.Size() < sizeof(MeshCacheHeader))
+			return fail();
+
+		std::memcpy(&header, file.Data(), sizeof(header));
+		if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(Vertex))
+			return fail();
+		if (header.indexSize != 2 && header.indexSize != 4)
+			return fail();
+		if (header.vertexOffset % MESH_CACHE_ALIGNMENT != 0 || header.indexOffset % MESH_CACHE_ALIGNMENT != 0)
+			return fail();
+		if (header.vertexOffset + header.vertexCount * sizeof(Vertex) > file.Size() ||
+			header.indexOffset + header.indexCount * header.indexSize > file.Size())
+			return fail();
+		if (expectedSource && (header.sourceSize != expectedSource->size || header.sourceModified != expectedSource->modified))
+			return fail();
+
+		return true;
+	}
+
+	void Close() { file.Close(); }
+
+	const MeshCacheHeader& Header() const { return header; }
+	const void* Vertices() const { return file.Data() + header.vertexOffset; }
+	const void* Indices() const { return file.Data() + header.indexOffset; }
+	size_t VertexCount() const { return (size_t)header.vertexCount; }
+	size_t IndexCount() const { return (size_t)header.indexCount; }
+	bool ShortIndices() const { return header.indexSize == 2; }
+
+private:
+	MappedFile file;
+	MeshCacheHeader header = {};
+
+	bool fail()
+	{
+		file.Close();
+		return false;
+	}
+};
+
+#endif
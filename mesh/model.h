@@ -0,0 +1,78 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "meshCache.h"
+#include "../renderer/glState.h"
+#include "objLoader.h"
+
+#include <string>
+#include <iostream>
+
+//a single-mesh model loaded from an OBJ file
+//the first load writes <file>.mesh next to the source, later loads map that instead of parsing
+class Model
+{
+public:
+	Mesh mesh;
+	unsigned int VAO = 0;
+	bool LoadedFromCache = false;
+
+	bool Load(const std::string& objPath)
+	{
+		FileStamp stamp;
+		if (!GetFileStamp(objPath, stamp)) {
+			std::cout << "ERROR::MODEL::FILE_NOT_FOUND " << objPath << std::endl;
+			return false;
+		}
+
+		std::string cachePath = objPath + ".mesh";
+		MeshCacheFile cache;
+		if (cache.Open(cachePath, &stamp)) {
+			mesh.UploadRaw(cache.Vertices(), cache.VertexCount(), cache.Indices(), cache.IndexCount(),
+				cache.ShortIndices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+			LoadedFromCache = true;
+		}
+		else {
+			MeshData data;
+			if (!LoadObjFile(objPath, data)) {
+				std::cout << "ERROR::MODEL::PARSE_FAILED " << objPath << std::endl;
+				return false;
+			}
+			OptimizeVertexCache(data.indices, data.vertices.size());
+			if (!WriteMeshCache(cachePath, data, stamp))
+				std::cout << "WARNING::MODEL::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+			mesh.Upload(data);
+			LoadedFromCache = false;
+		}
+
+		if (VAO == 0) glGenVertexArrays(1, &VAO);
+		GLState::Get().BindVertexArray(VAO);
+		mesh.AttachToBoundVAO();
+		GLState::Get().BindVertexArray(0);
+		return true;
+	}
+
+	void Draw() const
+	{
+		GLState::Get().BindVertexArray(VAO);
+		mesh.Draw();
+	}
+
+	void DrawPoints() const
+	{
+		GLState::Get().BindVertexArray(VAO);
+		mesh.DrawPoints();
+	}
+
+	void Destroy()
+	{
+		GLState::Get().DeleteVertexArrays(1, &VAO);
+		VAO = 0;
+		mesh.Destroy();
+	}
+};
+
+#endif
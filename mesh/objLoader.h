@@ -0,0 +1,300 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "meshBuilder.h"
+#include "../core/mappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Wavefront OBJ importer: positions, uvs, normals and polygonal faces (fan triangulated)
+//walks the mapped file with raw pointers, no iostreams and no per-line strings
+
+namespace objDetail {
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n') p++;
+		return p < end ? p + 1 : end;
+	}
+
+	inline float ParseFloat(const char*& p, const char* end)
+	{
+		static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+		p = SkipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+
+		double value = 0.0;
+		while (p < end && IsDigit(*p))
+			value = value * 10.0 + (*p++ - '0');
+
+		if (p < end && *p == '.') {
+			p++;
+			double fraction = 0.0;
+			int digits = 0;
+			while (p < end && IsDigit(*p)) {
+				if (digits < 18) {
+					fraction = fraction * 10.0 + (*p - '0');
+					digits++;
+				}
+				p++;
+			}
+			value += fraction / powersOf10[digits];
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int exponent = 0;
+			while (p < end && IsDigit(*p))
+				exponent = exponent * 10 + (*p++ - '0');
+			double scale = 1.0;
+			while (exponent > 18) {
+				scale *= 1e18;
+				exponent -= 18;
+			}
+			scale *= powersOf10[exponent];
+			value = negativeExponent ? value / scale : value * scale;
+		}
+
+		return (float)(negative ? -value : value);
+	}
+
+	inline int ParseInt(const char*& p, const char* end)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		int value = 0;
+		while (p < end && IsDigit(*p))
+			value = value * 10 + (*p++ - '0');
+		return negative ? -value : value;
+	}
+
+	//OBJ indices are 1 based, negative ones count back from the end, 0 means absent
+	inline int ResolveIndex(int index, size_t count)
+	{
+		if (index > 0) return index - 1;
+		if (index < 0) return (int)count + index;
+		return -1;
+	}
+
+	struct FaceKey {
+		int position;
+		int texCoord;
+		int normal;
+	};
+
+	//open addressing map from v/vt/vn triples to output vertex indices
+	class FaceKeyMap
+	{
+	public:
+		explicit FaceKeyMap(size_t expected)
+		{
+			size_t capacity = 1024;
+			while (capacity < expected * 2) capacity *= 2;
+			keys.resize(capacity);
+			values.assign(capacity, UINT32_MAX);
+			mask = capacity - 1;
+		}
+
+		//returns the stored index, or inserts newIndex and returns it
+		uint32_t FindOrInsert(const FaceKey& key, uint32_t newIndex)
+		{
+			if ((count + 1) * 2 > keys.size())
+				grow();
+
+			size_t slot = hash(key) & mask;
+			while (values[slot] != UINT32_MAX) {
+				const FaceKey& existing = keys[slot];
+				if (existing.position == key.position && existing.texCoord == key.texCoord && existing.normal == key.normal)
+					return values[slot];
+				slot = (slot + 1) & mask;
+			}
+			keys[slot] = key;
+			values[slot] = newIndex;
+			count++;
+			return newIndex;
+		}
+
+	private:
+		std::vector<FaceKey> keys;
+		std::vector<uint32_t> values;
+		size_t mask = 0;
+		size_t count = 0;
+
+		static size_t hash(const FaceKey& key)
+		{
+			uint64_t h = (uint64_t)(uint32_t)key.position * 0x9E3779B97F4A7C15ull;
+			h ^= (uint64_t)(uint32_t)key.texCoord * 0xC2B2AE3D27D4EB4Full;
+			h ^= (uint64_t)(uint32_t)key.normal * 0x165667B19E3779F9ull;
+			return (size_t)(h ^ (h >> 29));
+		}
+
+		void grow()
+		{
+			std::vector<FaceKey> oldKeys;
+			std::vector<uint32_t> oldValues;
+			oldKeys.swap(keys);
+			oldValues.swap(values);
+
+			keys.resize(oldKeys.size() * 2);
+			values.assign(oldValues.size() * 2, UINT32_MAX);
+			mask = keys.size() - 1;
+
+			for (size_t i = 0; i < oldKeys.size(); i++) {
+				if (oldValues[i] == UINT32_MAX) continue;
+				size_t slot = hash(oldKeys[i]) & mask;
+				while (values[slot] != UINT32_MAX)
+					slot = (slot + 1) & mask;
+				keys[slot] = oldKeys[i];
+				values[slot] = oldValues[i];
+			}
+		}
+	};
+}
+
+//parses OBJ text into a welded indexed mesh, normals are generated when the file has none
+inline bool ParseObj(const char* data, size_t size, MeshData& mesh)
+{
+	using namespace objDetail;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+
+	//rough guesses from file size so the vectors don't keep reallocating on big meshes
+	positions.reserve(size / 64);
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(size / 16);
+
+	FaceKeyMap keyMap(size / 64);
+	bool missingNormals = false;
+
+	const char* p = data;
+	const char* end = data + size;
+	std::vector<unsigned int> polygon;		//corners of the current face, reused so faces of any size cost no allocation once it has grown
+
+	while (p < end) {
+		p = SkipSpaces(p, end);
+		if (p >= end) break;
+
+		if (p[0] == 'v' && p + 1 < end && IsSpace(p[1])) {
+			p += 2;
+			float x = ParseFloat(p, end);
+			float y = ParseFloat(p, end);
+			float z = ParseFloat(p, end);
+			positions.emplace_back(x, y, z);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && IsSpace(p[2])) {
+			p += 3;
+			float u = ParseFloat(p, end);
+			float v = ParseFloat(p, end);
+			texCoords.emplace_back(u, v);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && IsSpace(p[2])) {
+			p += 3;
+			float x = ParseFloat(p, end);
+			float y = ParseFloat(p, end);
+			float z = ParseFloat(p, end);
+			normals.emplace_back(x, y, z);
+		}
+		else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1])) {
+			p++;
+			polygon.clear();
+			while (true) {
+				p = SkipSpaces(p, end);
+				if (p >= end || *p == '\n' || *p == '#' || !(IsDigit(*p) || *p == '-'))
+					break;
+
+				FaceKey key = { ResolveIndex(ParseInt(p, end), positions.size()), -1, -1 };
+				if (p < end && *p == '/') {
+					p++;
+					if (p < end && *p != '/')
+						key.texCoord = ResolveIndex(ParseInt(p, end), texCoords.size());
+					if (p < end && *p == '/') {
+						p++;
+						key.normal = ResolveIndex(ParseInt(p, end), normals.size());
+					}
+				}
+
+				if (key.position < 0 || key.position >= (int)positions.size())
+					return false;
+				if (key.texCoord >= (int)texCoords.size()) key.texCoord = -1;
+				if (key.normal >= (int)normals.size()) key.normal = -1;
+				missingNormals |= key.normal < 0;
+
+				uint32_t index = keyMap.FindOrInsert(key, (uint32_t)mesh.vertices.size());
+				if (index == mesh.vertices.size()) {
+					Vertex vertex;
+					vertex.position = positions[key.position];
+					vertex.normal = key.normal >= 0 ? normals[key.normal] : glm::vec3(0.0f);
+					vertex.texCoord = key.texCoord >= 0 ? texCoords[key.texCoord] : glm::vec2(0.0f);
+					mesh.vertices.push_back(vertex);
+				}
+
+				polygon.push_back(index);
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++) {
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+			}
+		}
+
+		p = SkipLine(p, end);
+	}
+
+	if (missingNormals) {
+		//area weighted face normals accumulated onto the vertices that lack one
+		std::vector<glm::vec3> accumulated(mesh.vertices.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+			glm::vec3 faceNormal = glm::cross(mesh.vertices[b].position - mesh.vertices[a].position, mesh.vertices[c].position - mesh.vertices[a].position);
+			accumulated[a] += faceNormal;
+			accumulated[b] += faceNormal;
+			accumulated[c] += faceNormal;
+		}
+		for (size_t v = 0; v < mesh.vertices.size(); v++) {
+			if (mesh.vertices[v].normal == glm::vec3(0.0f) && glm::dot(accumulated[v], accumulated[v]) > 0.0f)
+				mesh.vertices[v].normal = glm::normalize(accumulated[v]);
+		}
+	}
+
+	return !mesh.indices.empty();
+}
+
+inline bool LoadObjFile(const std::string& path, MeshData& mesh)
+{
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
+	return ParseObj(reinterpret_cast<const char*>(file.Data()), file.Size(), mesh);
+}
+
+#endif
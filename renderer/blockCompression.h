@@ -0,0 +1,249 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+
+//CPU BC1 (DXT1) and BC3 (DXT5) encoder/decoder for RGBA8 images
+//endpoints come from the colour bounding box, inset a little and flipped onto the dominant diagonal, then every texel picks its nearest palette entry
+//fast enough to cook on first run, decoders are only here for round trip quality checks
+
+enum class BlockFormat {
+	BC1,	//8 bytes per 4x4, opaque RGB
+	BC3		//16 bytes per 4x4, BC1 colour + interpolated alpha
+};
+
+inline size_t BlockBytes(BlockFormat format) { return format == BlockFormat::BC1 ? 8 : 16; }
+
+inline size_t CompressedSize(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+namespace bcDetail {
+	inline uint16_t PackRGB565(int r, int g, int b)
+	{
+		return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+	}
+
+	inline void UnpackRGB565(uint16_t c, int rgb[3])
+	{
+		int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	//BC1 palette, 3 colour + transparent mode when c0 <= c1 unless forceFourColor (BC3 always decodes 4 colour)
+	inline void ColorPalette(uint16_t c0, uint16_t c1, bool forceFourColor, int palette[4][4])
+	{
+		UnpackRGB565(c0, palette[0]);
+		UnpackRGB565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = 255;
+		if (c0 > c1 || forceFourColor) {
+			for (int k = 0; k < 3; k++) {
+				palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+				palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+			}
+			palette[2][3] = palette[3][3] = 255;
+		}
+		else {
+			for (int k = 0; k < 3; k++) {
+				palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+				palette[3][k] = 0;
+			}
+			palette[2][3] = 255;
+			palette[3][3] = 0;
+		}
+	}
+
+	inline void AlphaPalette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1) {
+			for (int i = 1; i < 7; i++)
+				palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+		else {
+			for (int i = 1; i < 5; i++)
+				palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	inline void EncodeColorBlock(const uint8_t block[64], uint8_t out[8])
+	{
+		int minC[3] = { 255, 255, 255 }, maxC[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			for (int k = 0; k < 3; k++) {
+				minC[k] = std::min(minC[k], (int)block[i * 4 + k]);
+				maxC[k] = std::max(maxC[k], (int)block[i * 4 + k]);
+			}
+		}
+
+		//the box diagonal from min to max assumes all channels rise together, flip g/b when they run against r
+		int center[3] = { (minC[0] + maxC[0]) / 2, (minC[1] + maxC[1]) / 2, (minC[2] + maxC[2]) / 2 };
+		int covRG = 0, covRB = 0;
+		for (int i = 0; i < 16; i++) {
+			int r = block[i * 4] - center[0];
+			covRG += r * (block[i * 4 + 1] - center[1]);
+			covRB += r * (block[i * 4 + 2] - center[2]);
+		}
+		if (covRG < 0) std::swap(minC[1], maxC[1]);
+		if (covRB < 0) std::swap(minC[2], maxC[2]);
+
+		//inset by 1/16 of the range so the endpoints sit on the data instead of its outliers
+		for (int k = 0; k < 3; k++) {
+			int inset = (maxC[k] - minC[k]) / 16;
+			maxC[k] -= inset;
+			minC[k] += inset;
+		}
+
+		uint16_t c0 = PackRGB565(maxC[0], maxC[1], maxC[2]);
+		uint16_t c1 = PackRGB565(minC[0], minC[1], minC[2]);
+		if (c0 < c1) std::swap(c0, c1);
+
+		uint32_t indices = 0;
+		if (c0 != c1) {
+			int palette[4][4];
+			ColorPalette(c0, c1, true, palette);
+			for (int i = 0; i < 16; i++) {
+				int best = 0, bestDistance = 1 << 30;
+				for (int p = 0; p < 4; p++) {
+					int dr = block[i * 4] - palette[p][0];
+					int dg = block[i * 4 + 1] - palette[p][1];
+					int db = block[i * 4 + 2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (uint32_t)best << (i * 2);
+			}
+		}
+
+		out[0] = (uint8_t)(c0 & 0xFF);
+		out[1] = (uint8_t)(c0 >> 8);
+		out[2] = (uint8_t)(c1 & 0xFF);
+		out[3] = (uint8_t)(c1 >> 8);
+		std::memcpy(out + 4, &indices, 4);
+	}
+
+	inline void EncodeAlphaBlock(const uint8_t block[64], uint8_t out[8])
+	{
+		int minA = 255, maxA = 0;
+		for (int i = 0; i < 16; i++) {
+			minA = std::min(minA, (int)block[i * 4 + 3]);
+			maxA = std::max(maxA, (int)block[i * 4 + 3]);
+		}
+
+		out[0] = (uint8_t)maxA;
+		out[1] = (uint8_t)minA;
+
+		uint64_t indices = 0;
+		if (maxA != minA) {
+			int palette[8];
+			AlphaPalette(maxA, minA, palette);
+			for (int i = 0; i < 16; i++) {
+				int a = block[i * 4 + 3];
+				int best = 0, bestDistance = 256;
+				for (int p = 0; p < 8; p++) {
+					int distance = std::abs(a - palette[p]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (uint64_t)best << (i * 3);
+			}
+		}
+
+		for (int b = 0; b < 6; b++)
+			out[2 + b] = (uint8_t)(indices >> (b * 8));
+	}
+
+	inline void DecodeColorBlock(const uint8_t in[8], bool forceFourColor, uint8_t block[64])
+	{
+		uint16_t c0 = (uint16_t)(in[0] | in[1] << 8);
+		uint16_t c1 = (uint16_t)(in[2] | in[3] << 8);
+		uint32_t indices;
+		std::memcpy(&indices, in + 4, 4);
+
+		int palette[4][4];
+		ColorPalette(c0, c1, forceFourColor, palette);
+		for (int i = 0; i < 16; i++) {
+			const int* color = palette[(indices >> (i * 2)) & 3];
+			for (int k = 0; k < 4; k++)
+				block[i * 4 + k] = (uint8_t)color[k];
+		}
+	}
+
+	inline void DecodeAlphaBlock(const uint8_t in[8], uint8_t block[64])
+	{
+		int palette[8];
+		AlphaPalette(in[0], in[1], palette);
+		uint64_t indices = 0;
+		for (int b = 0; b < 6; b++)
+			indices |= (uint64_t)in[2 + b] << (b * 8);
+		for (int i = 0; i < 16; i++)
+			block[i * 4 + 3] = (uint8_t)palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+//compresses a tightly packed RGBA8 image, partial edge blocks repeat the last row/column
+inline void CompressImage(const uint8_t* rgba, int width, int height, BlockFormat format, uint8_t* out)
+{
+	uint8_t block[64];
+	size_t blockBytes = BlockBytes(format);
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			for (int y = 0; y < 4; y++) {
+				const uint8_t* row = rgba + (size_t)std::min(by + y, height - 1) * width * 4;
+				for (int x = 0; x < 4; x++)
+					std::memcpy(block + (y * 4 + x) * 4, row + std::min(bx + x, width - 1) * 4, 4);
+			}
+
+			if (format == BlockFormat::BC3) {
+				bcDetail::EncodeAlphaBlock(block, out);
+				bcDetail::EncodeColorBlock(block, out + 8);
+			}
+			else {
+				bcDetail::EncodeColorBlock(block, out);
+			}
+			out += blockBytes;
+		}
+	}
+}
+
+inline void DecompressImage(const uint8_t* data, int width, int height, BlockFormat format, uint8_t* rgba)
+{
+	uint8_t block[64];
+	size_t blockBytes = BlockBytes(format);
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			if (format == BlockFormat::BC3) {
+				bcDetail::DecodeColorBlock(data + 8, true, block);
+				bcDetail::DecodeAlphaBlock(data, block);
+			}
+			else {
+				bcDetail::DecodeColorBlock(data, false, block);
+			}
+			data += blockBytes;
+
+			for (int y = 0; y < 4 && by + y < height; y++)
+				for (int x = 0; x < 4 && bx + x < width; x++)
+					std::memcpy(rgba + ((size_t)(by + y) * width + bx + x) * 4, block + (y * 4 + x) * 4, 4);
+		}
+	}
+}
+
+#endif
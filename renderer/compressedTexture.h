@@ -0,0 +1,155 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include "blockCompression.h"
+#include "mipChain.h"
+#include "../core/mappedFile.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+//.ctex cooked texture: header with a level table, then every mip level block compressed, 16 byte aligned
+//levels are stored in the exact layout glCompressedTexImage2D wants, loading is map + upload
+//bump COMPRESSED_TEXTURE_VERSION whenever the header or the encoder output changes
+
+const uint32_t COMPRESSED_TEXTURE_MAGIC = 0x58455443u; //"CTEX"
+const uint32_t COMPRESSED_TEXTURE_VERSION = 1;
+const int COMPRESSED_TEXTURE_MAX_LEVELS = 16;
+
+struct CompressedTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;			//BlockFormat
+	uint32_t flipped;			//rows were flipped on load, like stbi_set_flip_vertically_on_load
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t reserved;
+	uint64_t sourceSize;		//stamp of the image the file was cooked from
+	int64_t sourceModified;
+	uint64_t levelOffsets[COMPRESSED_TEXTURE_MAX_LEVELS];
+	uint64_t levelSizes[COMPRESSED_TEXTURE_MAX_LEVELS];
+};
+
+//BC1 when every texel is opaque, BC3 otherwise
+inline BlockFormat ChooseBlockFormat(const uint8_t* rgba, size_t texelCount)
+{
+	for (size_t i = 0; i < texelCount; i++)
+		if (rgba[i * 4 + 3] != 255)
+			return BlockFormat::BC3;
+	return BlockFormat::BC1;
+}
+
+//compresses every level of an RGBA8 chain into a .ctex file
+inline bool WriteCompressedTexture(const std::string& path, const MipChain& chain, BlockFormat format, bool flipped, const FileStamp& source)
+{
+	if (chain.channels != 4 || chain.levels.empty() || chain.levels.size() > (size_t)COMPRESSED_TEXTURE_MAX_LEVELS)
+		return false;
+
+	CompressedTextureHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = COMPRESSED_TEXTURE_MAGIC;
+	header.version = COMPRESSED_TEXTURE_VERSION;
+	header.format = (uint32_t)format;
+	header.flipped = flipped ? 1 : 0;
+	header.width = (uint32_t)chain.levels[0].width;
+	header.height = (uint32_t)chain.levels[0].height;
+	header.levelCount = (uint32_t)chain.levels.size();
+	header.sourceSize = source.size;
+	header.sourceModified = source.modified;
+
+	uint64_t offset = (sizeof(header) + 15) & ~15ull;
+	for (size_t i = 0; i < chain.levels.size(); i++) {
+		header.levelOffsets[i] = offset;
+		header.levelSizes[i] = CompressedSize(format, chain.levels[i].width, chain.levels[i].height);
+		offset = (offset + header.levelSizes[i] + 15) & ~15ull;
+	}
+
+	std::vector<uint8_t> bytes((size_t)offset, 0);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	for (size_t i = 0; i < chain.levels.size(); i++)
+		CompressImage(chain.LevelData(i), chain.levels[i].width, chain.levels[i].height, format, bytes.data() + header.levelOffsets[i]);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+	return (bool)file;
+}
+
+//full cook from decoded 8 bit pixels of any channel count: expand to RGBA, build mips, pick the format, compress, write
+inline bool CookCompressedTexture(const std::string& path, const uint8_t* pixels, int width, int height, int channels, bool flipped, const FileStamp& source)
+{
+	size_t texelCount = (size_t)width * height;
+	std::vector<uint8_t> rgba;
+	if (channels != 4) {
+		rgba.resize(texelCount * 4);
+		for (size_t i = 0; i < texelCount; i++) {
+			const uint8_t* in = pixels + i * channels;
+			uint8_t* out = rgba.data() + i * 4;
+			out[0] = in[0];
+			out[1] = channels >= 3 ? in[1] : in[0];
+			out[2] = channels >= 3 ? in[2] : in[0];
+			out[3] = channels == 2 ? in[1] : 255;
+		}
+		pixels = rgba.data();
+	}
+
+	MipChain chain;
+	BuildMipChain(pixels, width, height, 4, true, chain);
+	return WriteCompressedTexture(path, chain, ChooseBlockFormat(pixels, texelCount), flipped, source);
+}
+
+//maps a .ctex file, the level pointers point straight into the mapping
+class CompressedTextureFile
+{
+public:
+	//fails on a missing, damaged, foreign or stale file, or one cooked with the other flip setting
+	bool Open(const std::string& path, const FileStamp* expectedSource = nullptr, int expectedFlip = -1)
+	{
+		if (!file.Open(path) || file.Size() < sizeof(CompressedTextureHeader))
+			return fail();
+
+		std::memcpy(&header, file.Data(), sizeof(header));
+		if (header.magic != COMPRESSED_TEXTURE_MAGIC || header.version != COMPRESSED_TEXTURE_VERSION)
+			return fail();
+		if (header.format > (uint32_t)BlockFormat::BC3 || header.levelCount == 0 || header.levelCount > (uint32_t)COMPRESSED_TEXTURE_MAX_LEVELS)
+			return fail();
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			if (header.levelOffsets[i] + header.levelSizes[i] > file.Size() ||
+				header.levelSizes[i] != CompressedSize(Format(), LevelWidth(i), LevelHeight(i)))
+				return fail();
+		}
+		if (expectedSource && (header.sourceSize != expectedSource->size || header.sourceModified != expectedSource->modified))
+			return fail();
+		if (expectedFlip >= 0 && header.flipped != (uint32_t)expectedFlip)
+			return fail();
+
+		return true;
+	}
+
+	void Close() { file.Close(); }
+
+	BlockFormat Format() const { return (BlockFormat)header.format; }
+	int LevelCount() const { return (int)header.levelCount; }
+	int LevelWidth(uint32_t level) const { return std::max(1, (int)(header.width >> level)); }
+	int LevelHeight(uint32_t level) const { return std::max(1, (int)(header.height >> level)); }
+	const uint8_t* LevelData(uint32_t level) const { return file.Data() + header.levelOffsets[level]; }
+	size_t LevelSize(uint32_t level) const { return (size_t)header.levelSizes[level]; }
+	size_t FileSize() const { return file.Size(); }
+
+private:
+	MappedFile file;
+	CompressedTextureHeader header = {};
+
+	bool fail()
+	{
+		file.Close();
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glExtensions.h"
+#include "glState.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+//ARB_buffer_storage (core in 4.4), looked up at runtime since the loader targets 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNDEBUGDRAWBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+//16 byte line vertex: position + RGBA8 colour
+struct DebugVertex {
+	glm::vec3 position;
+	uint32_t color;
+};
+
+static_assert(sizeof(DebugVertex) == 16, "DebugVertex must stay packed");
+
+inline uint32_t PackColorRGBA8(const glm::vec3& color, float alpha = 1.0f)
+{
+	auto channel = [](float c) { return (uint32_t)(glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	return channel(color.r) | channel(color.g) << 8 | channel(color.b) << 16 | channel(alpha) << 24;
+}
+
+//immediate mode line renderer
+//one vertex buffer split into FRAME_COUNT segments, the frame writes into its own segment and fences it at EndFrame,
+//so the CPU never touches memory the GPU may still be reading
+//with buffer storage the segments are persistently mapped and Line writes straight into them,
+//on plain 3.3 lines collect in a staging array that Flush copies in through an unsynchronized map
+//capacity only grows (doubling) into a fresh buffer, GL keeps the old one alive for draws still in flight
+class DebugDraw
+{
+public:
+	static const int FRAME_COUNT = 3;
+
+	//loader is the same proc loader glad was initialised with
+	void Init(GLADloadproc loader, size_t initialCapacity = 4096)
+	{
+		bufferStorage = nullptr;
+		if (HasGLExtension("GL_ARB_buffer_storage"))
+			bufferStorage = (PFNDEBUGDRAWBUFFERSTORAGEPROC)loader("glBufferStorage");
+
+		glGenVertexArrays(1, &VAO);
+		allocate(initialCapacity);
+	}
+
+	void Destroy()
+	{
+		waitForAll();
+		release();
+		GLState::Get().DeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+
+	bool Persistent() const { return bufferStorage != nullptr; }
+	size_t Capacity() const { return capacity; }
+	size_t Pending() const { return count - flushed; }
+
+	void Line(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color)
+	{
+		if (count + 2 > capacity)
+			grow(count + 2);
+
+		uint32_t packed = PackColorRGBA8(color);
+		DebugVertex* out = writeBase + count;
+		out[0].position = from;
+		out[0].color = packed;
+		out[1].position = to;
+		out[1].color = packed;
+		count += 2;
+	}
+
+	//draws everything added since the last Flush, the caller binds the shader
+	//returns the number of bytes that went to the GPU
+	size_t Flush()
+	{
+		size_t pending = count - flushed;
+		if (pending == 0)
+			return 0;
+
+		size_t first = (size_t)segment * capacity + flushed;
+		if (!Persistent()) {
+			GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+			void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, first * sizeof(DebugVertex), pending * sizeof(DebugVertex),
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (mapped) {
+				std::memcpy(mapped, writeBase + flushed, pending * sizeof(DebugVertex));
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+		}
+
+		GLState::Get().BindVertexArray(VAO);
+		glDrawArrays(GL_LINES, (GLint)first, (GLsizei)pending);
+		GLState::Get().BindVertexArray(0);
+
+		flushed = count;
+		return pending * sizeof(DebugVertex);
+	}
+
+	//closes the frame's segment and moves on to the next one, waiting if the GPU is still reading it
+	void EndFrame()
+	{
+		if (count == 0)
+			return;
+
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		segment = (segment + 1) % FRAME_COUNT;
+		waitFor(segment);
+
+		count = 0;
+		flushed = 0;
+		writeBase = segmentBase(segment);
+	}
+
+	//times EndFrame had to block on a fence
+	int Stalls = 0;
+
+private:
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	PFNDEBUGDRAWBUFFERSTORAGEPROC bufferStorage = nullptr;
+	DebugVertex* mapped = nullptr;			//whole buffer, persistent path only
+	std::vector<DebugVertex> staging;		//current segment, fallback path only
+	DebugVertex* writeBase = nullptr;
+	GLsync fences[FRAME_COUNT] = {};
+	size_t capacity = 0;		//vertices per segment
+	size_t count = 0;			//vertices written this frame
+	size_t flushed = 0;			//of which already drawn
+	int segment = 0;
+
+	DebugVertex* segmentBase(int index)
+	{
+		return Persistent() ? mapped + (size_t)index * capacity : staging.data();
+	}
+
+	void allocate(size_t newCapacity)
+	{
+		capacity = newCapacity;
+		GLsizeiptr bytes = (GLsizeiptr)(capacity * FRAME_COUNT * sizeof(DebugVertex));
+
+		glGenBuffers(1, &VBO);
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (Persistent()) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			bufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+			mapped = (DebugVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+		}
+		else {
+			glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+			staging.resize(capacity);
+		}
+
+		GLState::Get().BindVertexArray(VAO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, position));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+		glEnableVertexAttribArray(1);
+		GLState::Get().BindVertexArray(0);
+
+		writeBase = segmentBase(segment);
+	}
+
+	void release()
+	{
+		if (mapped) {
+			GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			mapped = nullptr;
+		}
+		GLState::Get().DeleteBuffers(1, &VBO);
+		VBO = 0;
+	}
+
+	void waitFor(int index)
+	{
+		if (!fences[index])
+			return;
+		if (glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+			Stalls++;
+			glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		}
+		glDeleteSync(fences[index]);
+		fences[index] = nullptr;
+	}
+
+	void waitForAll()
+	{
+		for (int i = 0; i < FRAME_COUNT; i++)
+			waitFor(i);
+	}
+
+	//the fences guard the old buffer, nothing in the new one is in use yet
+	void dropFences()
+	{
+		for (int i = 0; i < FRAME_COUNT; i++) {
+			if (fences[i]) glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+	}
+
+	//new buffer at least twice the size, the not yet drawn part of this frame moves to the start of its segment
+	void grow(size_t needed)
+	{
+		std::vector<DebugVertex> carried(writeBase + flushed, writeBase + count);
+
+		dropFences();
+		release();
+		allocate(std::max(needed - flushed, capacity * 2));
+
+		count = carried.size();
+		flushed = 0;
+		if (!carried.empty())
+			std::memcpy(writeBase, carried.data(), carried.size() * sizeof(DebugVertex));
+	}
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "glState.h"
+
+//deferred path targets, 12 bytes a pixel:
+//  RGBA8  albedo (rgb) + specular intensity (a)
+//  RG16   octahedral normal (shaders/octahedral.glsl)
+//  D24    depth, world positions are rebuilt from it in the lighting pass
+class GBuffer
+{
+public:
+	unsigned int FBO = 0;
+	unsigned int AlbedoSpecular = 0;
+	unsigned int Normal = 0;
+	unsigned int Depth = 0;
+	int Width = 0;
+	int Height = 0;
+
+	bool Init(int width, int height)
+	{
+		Width = width;
+		Height = height;
+
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		AlbedoSpecular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+		Normal = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+		Depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, AlbedoSpecular, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, Normal, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, Depth, 0);
+
+		const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, attachments);
+
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return complete;
+	}
+
+	//recreates the targets when the framebuffer changed size, false if the new ones are incomplete
+	bool Resize(int width, int height)
+	{
+		if (FBO != 0 && width == Width && height == Height) return true;
+		Destroy();
+		return Init(width, height);
+	}
+
+	void Destroy()
+	{
+		const unsigned int textures[] = { AlbedoSpecular, Normal, Depth };
+		GLState::Get().DeleteTextures(3, textures);
+		glDeleteFramebuffers(1, &FBO);
+		FBO = AlbedoSpecular = Normal = Depth = 0;
+	}
+
+	void Bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	}
+
+	//gAlbedoSpecular, gNormal and gDepth of the lighting pass on three consecutive units
+	void BindTextures(GLenum firstUnit) const
+	{
+		const unsigned int textures[] = { AlbedoSpecular, Normal, Depth };
+		for (int i = 0; i < 3; i++) {
+			GLState::Get().ActiveTexture(firstUnit + i);
+			GLState::Get().BindTexture(GL_TEXTURE_2D, textures[i]);
+		}
+	}
+
+	size_t MemoryBytes() const { return (size_t)Width * Height * 12; }
+
+private:
+	//fetched with texelFetch, so no filtering and no mips
+	unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type)
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+//runtime check against the context's extension list (core profile, so glGetStringi)
+inline bool HasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+//shadow copy of the binding and fixed function state the renderer touches, calls that wouldn't change anything never reach GL
+//everything starts out unknown, so the first call of each kind is always issued
+//state changed behind its back has to be reported with Invalidate; ImGui's backend restores everything it touches, so it is fine
+//element array buffers are VAO state and are still bound directly, texture and buffer targets not listed below pass straight through
+class GLState
+{
+public:
+	static GLState& Get()
+	{
+		static GLState instance;
+		return instance;
+	}
+
+	enum { MAX_TEXTURE_UNITS = 16 };
+
+	//calls since ResetCounters that went to GL and that were skipped
+	int Issued = 0;
+	int Elided = 0;
+
+	void ResetCounters()
+	{
+		Issued = 0;
+		Elided = 0;
+	}
+
+	void Invalidate()
+	{
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+				textures[unit][target] = UNKNOWN;
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+			buffers[target] = UNKNOWN;
+		for (int capability = 0; capability < CAPABILITY_COUNT; capability++)
+			capabilities[capability] = UNKNOWN;
+		polygonMode = UNKNOWN;
+		depthFunc = UNKNOWN;
+		depthMask = UNKNOWN;
+		blendSource = UNKNOWN;
+		blendDestination = UNKNOWN;
+	}
+
+	void UseProgram(GLuint id)
+	{
+		if (changed(program, id))
+			glUseProgram(id);
+	}
+
+	void BindVertexArray(GLuint id)
+	{
+		if (changed(vertexArray, id))
+			glBindVertexArray(id);
+	}
+
+	//unit is GL_TEXTURE0 + n, like glActiveTexture
+	void ActiveTexture(GLenum unit)
+	{
+		if (changed(activeUnit, unit - GL_TEXTURE0))
+			glActiveTexture(unit);
+	}
+
+	//on the active unit
+	void BindTexture(GLenum target, GLuint id)
+	{
+		int slot = textureSlot(target);
+		if (slot < 0 || activeUnit >= MAX_TEXTURE_UNITS) {
+			Issued++;
+			glBindTexture(target, id);
+			return;
+		}
+		if (changed(textures[activeUnit][slot], id))
+			glBindTexture(target, id);
+	}
+
+	void BindBuffer(GLenum target, GLuint id)
+	{
+		int slot = bufferSlot(target);
+		if (slot < 0) {
+			Issued++;
+			glBindBuffer(target, id);
+			return;
+		}
+		if (changed(buffers[slot], id))
+			glBindBuffer(target, id);
+	}
+
+	//always issued, the indexed binding isn't shadowed, but it moves the generic binding point too
+	void BindBufferBase(GLenum target, GLuint index, GLuint id)
+	{
+		Issued++;
+		glBindBufferBase(target, index, id);
+		int slot = bufferSlot(target);
+		if (slot >= 0)
+			buffers[slot] = id;
+	}
+
+	void Enable(GLenum capability) { setCapability(capability, true); }
+	void Disable(GLenum capability) { setCapability(capability, false); }
+
+	//core profile only has GL_FRONT_AND_BACK
+	void PolygonMode(GLenum face, GLenum mode)
+	{
+		if (changed(polygonMode, mode))
+			glPolygonMode(face, mode);
+	}
+
+	void DepthFunc(GLenum func)
+	{
+		if (changed(depthFunc, func))
+			glDepthFunc(func);
+	}
+
+	void DepthMask(GLboolean flag)
+	{
+		if (changed(depthMask, flag ? 1u : 0u))
+			glDepthMask(flag);
+	}
+
+	void BlendFunc(GLenum source, GLenum destination)
+	{
+		if (source == blendSource && destination == blendDestination) {
+			Elided++;
+			return;
+		}
+		blendSource = source;
+		blendDestination = destination;
+		Issued++;
+		glBlendFunc(source, destination);
+	}
+
+	//GL unbinds deleted objects, and a later object may well get the same name back, so the shadow has to forget them too
+	void DeleteTextures(GLsizei count, const GLuint* ids)
+	{
+		for (GLsizei i = 0; i < count; i++)
+			for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+				for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+					if (textures[unit][target] == ids[i])
+						textures[unit][target] = 0;
+		glDeleteTextures(count, ids);
+	}
+
+	void DeleteBuffers(GLsizei count, const GLuint* ids)
+	{
+		for (GLsizei i = 0; i < count; i++)
+			for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+				if (buffers[target] == ids[i])
+					buffers[target] = 0;
+		glDeleteBuffers(count, ids);
+	}
+
+	void DeleteVertexArrays(GLsizei count, const GLuint* ids)
+	{
+		for (GLsizei i = 0; i < count; i++)
+			if (vertexArray == ids[i])
+				vertexArray = 0;
+		glDeleteVertexArrays(count, ids);
+	}
+
+private:
+	enum : GLuint { UNKNOWN = 0xFFFFFFFFu };
+	enum { TEXTURE_TARGET_COUNT = 2, BUFFER_TARGET_COUNT = 4, CAPABILITY_COUNT = 3 };
+
+	GLState() { Invalidate(); }
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeUnit;
+	GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	GLuint buffers[BUFFER_TARGET_COUNT];
+	GLuint capabilities[CAPABILITY_COUNT];
+	GLuint polygonMode;
+	GLuint depthFunc;
+	GLuint depthMask;
+	GLuint blendSource;
+	GLuint blendDestination;
+
+	bool changed(GLuint& cached, GLuint value)
+	{
+		if (cached == value) {
+			Elided++;
+			return false;
+		}
+		cached = value;
+		Issued++;
+		return true;
+	}
+
+	static int textureSlot(GLenum target)
+	{
+		switch (target) {
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_BUFFER: return 1;
+		default: return -1;
+		}
+	}
+
+	static int bufferSlot(GLenum target)
+	{
+		switch (target) {
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_UNIFORM_BUFFER: return 1;
+		case GL_TEXTURE_BUFFER: return 2;
+		case GL_PIXEL_UNPACK_BUFFER: return 3;
+		default: return -1;
+		}
+	}
+
+	static int capabilitySlot(GLenum capability)
+	{
+		switch (capability) {
+		case GL_DEPTH_TEST: return 0;
+		case GL_BLEND: return 1;
+		case GL_CULL_FACE: return 2;
+		default: return -1;
+		}
+	}
+
+	void setCapability(GLenum capability, bool enabled)
+	{
+		int slot = capabilitySlot(capability);
+		if (slot >= 0 && !changed(capabilities[slot], enabled ? 1u : 0u))
+			return;
+		if (slot < 0)
+			Issued++;
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include "../core/profiler.h"
+
+#include <vector>
+#include <cstdint>
+
+//GPU time per render pass from GL_TIMESTAMP query pairs (timestamps, unlike GL_TIME_ELAPSED, can nest)
+//queries live in a ring of FRAME_LATENCY frames and a frame is only read back when its slot comes round again,
+//by then the GPU has normally finished it so reading never stalls; if it hasn't, that frame's results are skipped
+class GpuProfiler
+{
+public:
+	static const int FRAME_LATENCY = 4;
+	static const int MAX_PASSES = 32;
+
+	struct PassResult {
+		const char* name;
+		double milliseconds;
+		uint32_t depth;
+	};
+
+	static GpuProfiler& Get()
+	{
+		static GpuProfiler profiler;
+		return profiler;
+	}
+
+	void Init()
+	{
+		for (Frame& frame : frames) {
+			glGenQueries(MAX_PASSES * 2, frame.queries);
+			frame.passCount = 0;
+			frame.lastQuery = -1;
+			frame.issued = false;
+		}
+		initialized = true;
+	}
+
+	void Destroy()
+	{
+		if (!initialized) return;
+		for (Frame& frame : frames)
+			glDeleteQueries(MAX_PASSES * 2, frame.queries);
+		initialized = false;
+	}
+
+	//call once per frame before the first pass, collects the frame that last used this slot
+	void BeginFrame()
+	{
+		if (!initialized) return;
+		current = (current + 1) % FRAME_LATENCY;
+		Frame& frame = frames[current];
+
+		if (frame.issued)
+			collect(frame);
+
+		frame.passCount = 0;
+		frame.lastQuery = -1;
+		frame.issued = true;
+		depth = 0;
+	}
+
+	//returns a pass handle for EndPass, -1 when the frame is out of query slots
+	int BeginPass(const char* name)
+	{
+		if (!initialized) return -1;
+		Frame& frame = frames[current];
+		if (frame.passCount >= MAX_PASSES)
+			return -1;
+
+		int pass = frame.passCount++;
+		frame.names[pass] = name;
+		frame.depths[pass] = depth++;
+		glQueryCounter(frame.queries[pass * 2], GL_TIMESTAMP);
+		frame.lastQuery = pass * 2;
+		return pass;
+	}
+
+	void EndPass(int pass)
+	{
+		if (pass < 0) return;
+		Frame& frame = frames[current];
+		glQueryCounter(frame.queries[pass * 2 + 1], GL_TIMESTAMP);
+		frame.lastQuery = pass * 2 + 1;
+		depth--;
+	}
+
+	//most recent frame that was read back, FRAME_LATENCY - 1 frames behind
+	std::vector<PassResult> LastResults;
+	double LastFrameMilliseconds = 0.0;		//first pass start to last pass end
+	int SkippedFrames = 0;					//read back was due but the GPU hadn't finished
+
+private:
+	struct Frame {
+		GLuint queries[MAX_PASSES * 2];
+		const char* names[MAX_PASSES];
+		uint32_t depths[MAX_PASSES];
+		int passCount;
+		int lastQuery;		//the stamp issued last, with nested passes that's the outer pass's end, not the last pass's
+		bool issued;
+	};
+
+	Frame frames[FRAME_LATENCY];
+	int current = 0;
+	uint32_t depth = 0;
+	bool initialized = false;
+
+	void collect(Frame& frame)
+	{
+		if (frame.passCount == 0 || frame.lastQuery < 0)
+			return;
+
+		//queries complete in order, so the stamp issued last being ready means all of them are
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			SkippedFrames++;
+			return;
+		}
+
+		LastResults.clear();
+		GLuint64 first = UINT64_MAX, last = 0;
+		for (int i = 0; i < frame.passCount; i++) {
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+			LastResults.push_back({ frame.names[i], (end - start) / 1e6, frame.depths[i] });
+			if (start < first) first = start;
+			if (end > last) last = end;
+		}
+		LastFrameMilliseconds = (last - first) / 1e6;
+	}
+};
+
+//times the enclosing block on the GPU
+class GpuScope
+{
+public:
+	explicit GpuScope(const char* name) : pass(GpuProfiler::Get().BeginPass(name)) {}
+	~GpuScope() { End(); }
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+
+	void End()
+	{
+		GpuProfiler::Get().EndPass(pass);
+		pass = -1;
+	}
+
+private:
+	int pass;
+};
+
+#ifndef PROFILER_DISABLED
+#define GPU_PROFILE_SCOPE(name) GpuScope PROFILE_CONCAT(gpuScope, __LINE__)(name)
+#else
+#define GPU_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif
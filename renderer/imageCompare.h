@@ -0,0 +1,96 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+//golden image support for headless runs: binary PPM output and a perceptual diff
+//the diff is CIE76 delta E in Lab space, 2.3 is roughly one just noticeable difference
+
+inline bool WritePPM(const std::string& path, const unsigned char* rgb, int width, int height)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(rgb), (std::streamsize)width * height * 3);
+	return (bool)file;
+}
+
+struct ImageDiff {
+	double meanDeltaE = 0.0;
+	double maxDeltaE = 0.0;
+	double percentAboveJnd = 0.0;	//pixels a viewer could tell apart
+};
+
+const double JUST_NOTICEABLE_DELTA_E = 2.3;
+
+namespace imageDetail {
+	inline double SrgbToLinear(double c)
+	{
+		return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+	}
+
+	inline double LabF(double t)
+	{
+		return t > 0.008856 ? std::cbrt(t) : 7.787 * t + 16.0 / 116.0;
+	}
+
+	//sRGB byte triple to CIE Lab, D65 white
+	struct Lab { double L, a, b; };
+
+	inline void BuildLabTable(std::vector<double>& linear)
+	{
+		linear.resize(256);
+		for (int i = 0; i < 256; i++)
+			linear[i] = SrgbToLinear(i / 255.0);
+	}
+
+	inline Lab ToLab(const unsigned char* rgb, const std::vector<double>& linear)
+	{
+		double r = linear[rgb[0]], g = linear[rgb[1]], b = linear[rgb[2]];
+		double x = (0.4124 * r + 0.3576 * g + 0.1805 * b) / 0.95047;
+		double y = 0.2126 * r + 0.7152 * g + 0.0722 * b;
+		double z = (0.0193 * r + 0.1192 * g + 0.9505 * b) / 1.08883;
+		double fx = LabF(x), fy = LabF(y), fz = LabF(z);
+		return { 116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz) };
+	}
+}
+
+//both images tightly packed RGB8 with the same pixel count
+inline ImageDiff ComparePerceptual(const unsigned char* a, const unsigned char* b, size_t pixelCount)
+{
+	std::vector<double> linear;
+	imageDetail::BuildLabTable(linear);
+
+	ImageDiff diff;
+	size_t aboveJnd = 0;
+	double sum = 0.0;
+	for (size_t i = 0; i < pixelCount; i++) {
+		const unsigned char* pa = a + i * 3;
+		const unsigned char* pb = b + i * 3;
+		if (pa[0] == pb[0] && pa[1] == pb[1] && pa[2] == pb[2])
+			continue;
+
+		imageDetail::Lab la = imageDetail::ToLab(pa, linear);
+		imageDetail::Lab lb = imageDetail::ToLab(pb, linear);
+		double deltaE = std::sqrt((la.L - lb.L) * (la.L - lb.L) + (la.a - lb.a) * (la.a - lb.a) + (la.b - lb.b) * (la.b - lb.b));
+
+		sum += deltaE;
+		diff.maxDeltaE = std::max(diff.maxDeltaE, deltaE);
+		if (deltaE > JUST_NOTICEABLE_DELTA_E)
+			aboveJnd++;
+	}
+
+	if (pixelCount > 0) {
+		diff.meanDeltaE = sum / pixelCount;
+		diff.percentAboveJnd = 100.0 * aboveJnd / pixelCount;
+	}
+	return diff;
+}
+
+#endif
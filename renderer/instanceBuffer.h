@@ -0,0 +1,102 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glState.h"
+
+#include <vector>
+#include <cstddef>
+
+//per instance vertex data, consumed by the INSTANCED variant of vertex.glsl
+struct InstanceData {
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+	glm::vec3 color;
+};
+
+//attribute locations, the mesh itself uses 0-2
+const GLuint INSTANCE_MODEL_LOCATION = 3;		// 3..6
+const GLuint INSTANCE_NORMAL_LOCATION = 7;		// 7..9
+const GLuint INSTANCE_COLOR_LOCATION = 10;
+
+//long lived instance VBO, storage only grows (geometrically) so steady state updates are glBufferSubData
+class InstanceBuffer
+{
+public:
+	unsigned int VBO = 0;
+
+	void Init(size_t initialCapacity = 64)
+	{
+		glGenBuffers(1, &VBO);
+		reserve(initialCapacity);
+	}
+
+	void Destroy()
+	{
+		GLState::Get().DeleteBuffers(1, &VBO);
+		VBO = 0;
+		capacity = 0;
+		count = 0;
+	}
+
+	//binds the instance attributes of this buffer into the currently bound VAO
+	void AttachToBoundVAO() const
+	{
+		const GLsizei stride = sizeof(InstanceData);
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		for (GLuint column = 0; column < 4; column++) {
+			GLuint location = INSTANCE_MODEL_LOCATION + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+
+		for (GLuint column = 0; column < 3; column++) {
+			GLuint location = INSTANCE_NORMAL_LOCATION + column;
+			glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+
+		glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(InstanceData, color));
+		glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+		glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+	}
+
+	//returns the number of bytes sent to the GPU
+	size_t Upload(const std::vector<InstanceData>& instances)
+	{
+		count = instances.size();
+		if (count == 0) return 0;
+
+		size_t bytes = count * sizeof(InstanceData);
+		if (count > capacity) {
+			size_t newCapacity = capacity == 0 ? 64 : capacity;
+			while (newCapacity < count)
+				newCapacity *= 2;
+			reserve(newCapacity);
+		}
+
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances.data());
+		return bytes;
+	}
+
+	size_t Count() const { return count; }
+
+private:
+	size_t capacity = 0;
+	size_t count = 0;
+
+	void reserve(size_t newCapacity)
+	{
+		capacity = newCapacity;
+		GLState::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+	}
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef LIGHT_BLOCK_H
+#define LIGHT_BLOCK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glState.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+//CPU mirror of the std140 LightBlock declared in shaders/lights.glsl, plus the point lights
+//the point lights don't fit a UBO in the thousands, they live in a texture buffer of 4 RGBA32F texels each
+//edits only mark the touched byte range dirty, Flush() uploads that range with one glBufferSubData per buffer
+
+const GLuint LIGHT_BLOCK_BINDING = 0;
+
+struct DirLightStd140 {
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct PointLightStd140 {
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float range;		//where the falloff window reaches zero, 0 when the light is disabled
+};
+
+static_assert(sizeof(DirLightStd140) == 64, "DirLight must match the std140 layout");
+static_assert(sizeof(PointLightStd140) == 64, "PointLight must be 4 texels of pointLightData");
+
+class LightBlock
+{
+public:
+	//4 texels per light, 16384 lights is the 65536 texel minimum GL 3.3 guarantees for a texture buffer
+	static const int MAX_POINT_LIGHTS = 16384;
+
+	struct Data {
+		int lightCounts[4];
+		DirLightStd140 dirLight;
+	};
+
+	unsigned int UBO = 0;
+	unsigned int PointLightTBO = 0;
+	unsigned int PointLightTexture = 0;
+
+	void Init()
+	{
+		data = Data();
+		pointLights.clear();
+
+		glGenBuffers(1, &UBO);
+		GLState::Get().BindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), &data, GL_DYNAMIC_DRAW);
+		GLState::Get().BindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, UBO);
+		GLState::Get().BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glGenBuffers(1, &PointLightTBO);
+		glGenTextures(1, &PointLightTexture);
+		pointCapacity = 0;
+		reservePointLights(64);
+
+		clearDirty(uniformDirty);
+		clearDirty(pointDirty);
+	}
+
+	void Destroy()
+	{
+		GLState::Get().DeleteBuffers(1, &UBO);
+		GLState::Get().DeleteBuffers(1, &PointLightTBO);
+		GLState::Get().DeleteTextures(1, &PointLightTexture);
+		UBO = PointLightTBO = PointLightTexture = 0;
+	}
+
+	void SetPointLightCount(int count)
+	{
+		if ((int)pointLights.size() < count)
+			pointLights.resize(count, PointLightStd140());
+		if (data.lightCounts[0] == count) return;
+		data.lightCounts[0] = count;
+		markDirty(uniformDirty, offsetof(Data, lightCounts), sizeof(data.lightCounts));
+	}
+
+	int GetPointLightCount() const { return data.lightCounts[0]; }
+
+	void SetDirLight(const DirLightStd140& light)
+	{
+		if (std::memcmp(&data.dirLight, &light, sizeof(light)) == 0) return;
+		data.dirLight = light;
+		markDirty(uniformDirty, offsetof(Data, dirLight), sizeof(light));
+	}
+
+	void SetPointLight(int index, const PointLightStd140& light)
+	{
+		if (index >= (int)pointLights.size())
+			pointLights.resize(index + 1, PointLightStd140());
+		else if (std::memcmp(&pointLights[index], &light, sizeof(light)) == 0)
+			return;
+		pointLights[index] = light;
+		markDirty(pointDirty, index * sizeof(PointLightStd140), sizeof(light));
+	}
+
+	bool IsDirty() const { return uniformDirty.IsDirty() || pointDirty.IsDirty(); }
+
+	//uploads the dirty ranges, returns the number of bytes sent (0 on idle frames)
+	//a light count past the texture buffer's capacity reallocates it and sends every light
+	size_t Flush()
+	{
+		size_t uploaded = 0;
+		if (uniformDirty.IsDirty()) {
+			size_t size = uniformDirty.end - uniformDirty.begin;
+			GLState::Get().BindBuffer(GL_UNIFORM_BUFFER, UBO);
+			glBufferSubData(GL_UNIFORM_BUFFER, uniformDirty.begin, size, reinterpret_cast<const unsigned char*>(&data) + uniformDirty.begin);
+			GLState::Get().BindBuffer(GL_UNIFORM_BUFFER, 0);
+			uploaded += size;
+			clearDirty(uniformDirty);
+		}
+
+		if (pointLights.size() > pointCapacity) {
+			size_t capacity = pointCapacity;
+			while (capacity < pointLights.size())
+				capacity *= 2;
+			reservePointLights(capacity);
+			markDirty(pointDirty, 0, pointLights.size() * sizeof(PointLightStd140));
+		}
+		if (pointDirty.IsDirty()) {
+			size_t end = std::min(pointDirty.end, pointLights.size() * sizeof(PointLightStd140));
+			if (end > pointDirty.begin) {
+				GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, PointLightTBO);
+				glBufferSubData(GL_TEXTURE_BUFFER, pointDirty.begin, end - pointDirty.begin, reinterpret_cast<const unsigned char*>(pointLights.data()) + pointDirty.begin);
+				GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, 0);
+				uploaded += end - pointDirty.begin;
+			}
+			clearDirty(pointDirty);
+		}
+		return uploaded;
+	}
+
+	//pointLightData in lights.glsl
+	void BindPointLights(GLenum textureUnit) const
+	{
+		GLState::Get().ActiveTexture(textureUnit);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, PointLightTexture);
+	}
+
+private:
+	struct DirtyRange {
+		size_t begin = 0;
+		size_t end = 0;
+
+		bool IsDirty() const { return end > begin; }
+	};
+
+	Data data;
+	std::vector<PointLightStd140> pointLights;
+	size_t pointCapacity = 0;
+	DirtyRange uniformDirty;
+	DirtyRange pointDirty;
+
+	void reservePointLights(size_t capacity)
+	{
+		pointCapacity = capacity;
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, PointLightTBO);
+		glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(PointLightStd140), nullptr, GL_DYNAMIC_DRAW);
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		//re-attached so the texture never points at the old storage
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, PointLightTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, PointLightTBO);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	static void markDirty(DirtyRange& range, size_t offset, size_t size)
+	{
+		if (!range.IsDirty()) {
+			range.begin = offset;
+			range.end = offset + size;
+			return;
+		}
+		if (offset < range.begin) range.begin = offset;
+		if (offset + size > range.end) range.end = offset + size;
+	}
+
+	static void clearDirty(DirtyRange& range)
+	{
+		range.begin = (size_t)-1;
+		range.end = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,390 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../core/jobSystem.h"
+#include "../core/profiler.h"
+#include "../math/sphereCulling.h"
+#include "glState.h"
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE 1
+#include <emmintrin.h>
+#endif
+
+//distance at which a point light's attenuation times its brightest channel drops below cutoff,
+//past it the light is left out of the clusters and faded to zero in the shader (1/256 is under one step of an 8 bit target)
+inline float PointLightRange(float constant, float linear, float quadratic, float brightness, float cutoff = 1.0f / 256.0f)
+{
+	//constant + linear d + quadratic d^2 = brightness / cutoff
+	float k = brightness / cutoff - constant;
+	if (k <= 0.0f) return 0.0f;
+	if (quadratic <= 0.0f)
+		return linear > 0.0f ? k / linear : std::numeric_limits<float>::max();
+	return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * k)) / (2.0f * quadratic);
+}
+
+//clustered forward lighting: the view frustum is cut into GRID_X x GRID_Y screen tiles and GRID_Z depth slices
+//(exponential, so near clusters stay small), every frame each cluster gets the list of lights whose range reaches it
+//the lists go to two texture buffers (see ClusterIndex in shaders/lights.glsl), fragments then only shade those lights
+//
+//the build runs on the CPU, GL 3.3 has no compute shaders:
+//1) light spheres to view space and a conservative screen/depth range, 4 lights per SSE batch, off screen ones dropped
+//2) per depth slice (jobs on the JobSystem): the sphere's cross section in that slice gives its tile rect,
+//   counted per cluster
+//3) prefix sum of the counts, then the slices write their light indices into place (again in parallel)
+class LightClusters
+{
+public:
+	enum { GRID_X = 16, GRID_Y = 12, GRID_Z = 24, CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z };
+
+	unsigned int GridTBO = 0, GridTexture = 0;
+	unsigned int IndexTBO = 0, IndexTexture = 0;
+
+	//last Build
+	int LightsInView = 0;
+	size_t IndexCount = 0;
+	int MaxLightsPerCluster = 0;
+	bool Overflowed = false;		//more indices than the texture buffer holds, every cluster was capped evenly
+
+	//prepended to every shader that includes lights.glsl
+	static std::string ShaderDefines()
+	{
+		return "#define CLUSTER_GRID_X " + std::to_string((int)GRID_X) + "\n"
+			+ "#define CLUSTER_GRID_Y " + std::to_string((int)GRID_Y) + "\n"
+			+ "#define CLUSTER_GRID_Z " + std::to_string((int)GRID_Z) + "\n";
+	}
+
+	void Init()
+	{
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		maxIndices = std::max((size_t)maxTexels, (size_t)65536);
+
+		glGenBuffers(1, &GridTBO);
+		glGenTextures(1, &GridTexture);
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, GridTBO);
+		glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, GridTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, GridTBO);
+
+		glGenBuffers(1, &IndexTBO);
+		glGenTextures(1, &IndexTexture);
+		indexCapacity = 0;
+		reserveIndices(4096);
+
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, 0);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, 0);
+
+		grid.assign(CLUSTER_COUNT * 2, 0);
+		counts.assign(CLUSTER_COUNT, 0);
+		cursors.assign(CLUSTER_COUNT, 0);
+		sliceSpans.resize(GRID_Z);
+	}
+
+	void Destroy()
+	{
+		GLState::Get().DeleteBuffers(1, &GridTBO);
+		GLState::Get().DeleteTextures(1, &GridTexture);
+		GLState::Get().DeleteBuffers(1, &IndexTBO);
+		GLState::Get().DeleteTextures(1, &IndexTexture);
+		GridTBO = GridTexture = IndexTBO = IndexTexture = 0;
+	}
+
+	//lights are spheres (centre, range) in world space, owners[i] is the index the shader fetches for sphere i
+	//returns the bytes uploaded
+	size_t Build(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+		const BoundingSpheres& lights, const std::vector<uint32_t>& owners)
+	{
+		setupSlices(projection, nearPlane, farPlane);
+
+		{
+			PROFILE_SCOPE("Cluster lights to view");
+			gatherInView(view, lights);
+		}
+
+		{
+			PROFILE_SCOPE("Cluster binning");
+			std::fill(counts.begin(), counts.end(), 0u);
+			JobSystem::Get().ParallelFor(GRID_Z, 1, [this](size_t slice, size_t) {
+				PROFILE_SCOPE("Cluster slice count");
+				countSlice((int)slice);
+			});
+
+			//cap every cluster evenly if the lists would not fit the texture buffer
+			size_t total = 0;
+			for (uint32_t count : counts)
+				total += count;
+			Overflowed = total > maxIndices;
+			uint32_t cap = Overflowed ? (uint32_t)(maxIndices / CLUSTER_COUNT) : std::numeric_limits<uint32_t>::max();
+
+			uint32_t offset = 0;
+			MaxLightsPerCluster = 0;
+			for (int i = 0; i < CLUSTER_COUNT; i++) {
+				uint32_t count = std::min(counts[i], cap);
+				grid[i * 2] = offset;
+				grid[i * 2 + 1] = count;
+				cursors[i] = offset;
+				offset += count;
+				MaxLightsPerCluster = std::max(MaxLightsPerCluster, (int)count);
+			}
+			IndexCount = offset;
+			indices.resize(std::max(IndexCount, (size_t)1));
+
+			JobSystem::Get().ParallelFor(GRID_Z, 1, [this, &owners](size_t slice, size_t) {
+				PROFILE_SCOPE("Cluster slice fill");
+				fillSlice((int)slice, owners);
+			});
+		}
+
+		PROFILE_SCOPE("Cluster upload");
+		if (IndexCount > indexCapacity) {
+			size_t capacity = indexCapacity;
+			while (capacity < IndexCount)
+				capacity *= 2;
+			reserveIndices(std::min(capacity, maxIndices));
+		}
+
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, GridTBO);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, grid.size() * sizeof(uint32_t), grid.data());
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, IndexTBO);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, IndexCount * sizeof(uint32_t), indices.data());
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, 0);
+		return grid.size() * sizeof(uint32_t) + IndexCount * sizeof(uint32_t);
+	}
+
+	//clusterGrid and clusterLightIndices in lights.glsl
+	void Bind(GLenum gridUnit, GLenum indexUnit) const
+	{
+		GLState::Get().ActiveTexture(gridUnit);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, GridTexture);
+		GLState::Get().ActiveTexture(indexUnit);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, IndexTexture);
+	}
+
+	//clusterScale for a framebuffer of width x height, matches the slicing of the last Build
+	glm::vec4 ShaderScale(int width, int height) const
+	{
+		return glm::vec4((float)GRID_X / width, (float)GRID_Y / height, sliceScale, sliceBias);
+	}
+
+private:
+	//a light that survived the view test: view space centre (depth positive), range and slice span
+	struct ViewLight {
+		float x, y, depth, radius;
+		int firstSlice, lastSlice;
+		uint32_t index;
+	};
+
+	//a light's tile rect inside one slice
+	struct Span {
+		uint32_t light;
+		uint16_t x0, x1, y0, y1;
+	};
+
+	size_t maxIndices = 65536;
+	size_t indexCapacity = 0;
+
+	std::vector<uint32_t> grid;		//(offset, count) per cluster
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> cursors;
+	std::vector<uint32_t> indices;
+	std::vector<ViewLight> inView;
+	std::vector<std::vector<Span>> sliceSpans;
+
+	float nearDepth = 0.1f, farDepth = 100.0f;
+	float projectionX = 1.0f, projectionY = 1.0f;
+	float sliceScale = 1.0f, sliceBias = 0.0f;
+	float sliceDepth[GRID_Z + 1];
+
+	void reserveIndices(size_t capacity)
+	{
+		indexCapacity = capacity;
+		GLState::Get().BindBuffer(GL_TEXTURE_BUFFER, IndexTBO);
+		glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, IndexTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, IndexTBO);
+		GLState::Get().BindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	//slice = log(depth) * sliceScale - sliceBias, so slice 0 starts at near and GRID_Z ends at far
+	void setupSlices(const glm::mat4& projection, float nearPlane, float farPlane)
+	{
+		nearDepth = nearPlane;
+		farDepth = farPlane;
+		projectionX = projection[0][0];
+		projectionY = projection[1][1];
+		sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+		sliceBias = std::log(nearPlane) * sliceScale;
+		for (int z = 0; z <= GRID_Z; z++)
+			sliceDepth[z] = nearPlane * std::pow(farPlane / nearPlane, (float)z / GRID_Z);
+	}
+
+	int sliceOf(float depth) const
+	{
+		float slice = std::log(depth) * sliceScale - sliceBias;
+		return (int)std::max(0.0f, std::min((float)(GRID_Z - 1), slice));
+	}
+
+	static int tileOf(float ndc, int tiles)
+	{
+		float tile = (ndc * 0.5f + 0.5f) * tiles;
+		return (int)std::max(0.0f, std::min((float)(tiles - 1), tile));
+	}
+
+	//projected x/y extent of the box [centre +- halfWidth] between two depths, the extremes of x / depth sit on its corners
+	void screenRect(float x, float y, float halfWidth, float depth0, float depth1, float& minX, float& maxX, float& minY, float& maxY) const
+	{
+		minX = std::min((x - halfWidth) / depth0, (x - halfWidth) / depth1) * projectionX;
+		maxX = std::max((x + halfWidth) / depth0, (x + halfWidth) / depth1) * projectionX;
+		minY = std::min((y - halfWidth) / depth0, (y - halfWidth) / depth1) * projectionY;
+		maxY = std::max((y + halfWidth) / depth0, (y + halfWidth) / depth1) * projectionY;
+	}
+
+	void addInView(float x, float y, float depth, float radius, uint32_t index)
+	{
+		ViewLight light = { x, y, depth, radius, sliceOf(std::max(depth - radius, nearDepth)), sliceOf(std::min(depth + radius, farDepth)), index };
+		inView.push_back(light);
+	}
+
+	//scalar twin of the SSE batch below, also takes the tail
+	void gatherScalar(const glm::mat4& view, const BoundingSpheres& lights, size_t first)
+	{
+		for (size_t i = first; i < lights.Size(); i++) {
+			glm::vec3 position = glm::vec3(view * glm::vec4(lights.x[i], lights.y[i], lights.z[i], 1.0f));
+			float radius = lights.radius[i];
+			float depth = -position.z;
+			if (depth + radius < nearDepth || depth - radius > farDepth)
+				continue;
+
+			float minX, maxX, minY, maxY;
+			screenRect(position.x, position.y, radius, std::max(depth - radius, nearDepth), depth + radius, minX, maxX, minY, maxY);
+			if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+				continue;
+			addInView(position.x, position.y, depth, radius, (uint32_t)i);
+		}
+	}
+
+	void gatherInView(const glm::mat4& view, const BoundingSpheres& lights)
+	{
+		inView.clear();
+		size_t i = 0;
+
+#if defined(LIGHT_CLUSTERS_SSE)
+		__m128 row[3][4];
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				row[r][c] = _mm_set1_ps(view[c][r]);
+
+		const __m128 nearPlane = _mm_set1_ps(nearDepth), farPlane = _mm_set1_ps(farDepth);
+		const __m128 scaleX = _mm_set1_ps(projectionX), scaleY = _mm_set1_ps(projectionY);
+		const __m128 one = _mm_set1_ps(1.0f), minusOne = _mm_set1_ps(-1.0f);
+
+		for (; i + 4 <= lights.Size(); i += 4) {
+			__m128 x = _mm_loadu_ps(&lights.x[i]);
+			__m128 y = _mm_loadu_ps(&lights.y[i]);
+			__m128 z = _mm_loadu_ps(&lights.z[i]);
+			__m128 radius = _mm_loadu_ps(&lights.radius[i]);
+
+			__m128 viewPosition[3];
+			for (int r = 0; r < 3; r++)
+				viewPosition[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, row[r][0]), _mm_mul_ps(y, row[r][1])), _mm_add_ps(_mm_mul_ps(z, row[r][2]), row[r][3]));
+			__m128 depth = _mm_sub_ps(_mm_setzero_ps(), viewPosition[2]);
+			__m128 depth0 = _mm_max_ps(_mm_sub_ps(depth, radius), nearPlane);
+			__m128 depth1 = _mm_add_ps(depth, radius);
+
+			__m128 left = _mm_sub_ps(viewPosition[0], radius), right = _mm_add_ps(viewPosition[0], radius);
+			__m128 bottom = _mm_sub_ps(viewPosition[1], radius), top = _mm_add_ps(viewPosition[1], radius);
+			__m128 minX = _mm_mul_ps(_mm_min_ps(_mm_div_ps(left, depth0), _mm_div_ps(left, depth1)), scaleX);
+			__m128 maxX = _mm_mul_ps(_mm_max_ps(_mm_div_ps(right, depth0), _mm_div_ps(right, depth1)), scaleX);
+			__m128 minY = _mm_mul_ps(_mm_min_ps(_mm_div_ps(bottom, depth0), _mm_div_ps(bottom, depth1)), scaleY);
+			__m128 maxY = _mm_mul_ps(_mm_max_ps(_mm_div_ps(top, depth0), _mm_div_ps(top, depth1)), scaleY);
+
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(depth1, nearPlane), _mm_cmple_ps(_mm_sub_ps(depth, radius), farPlane));
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(maxX, minusOne), _mm_cmple_ps(minX, one)));
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(maxY, minusOne), _mm_cmple_ps(minY, one)));
+
+			int mask = _mm_movemask_ps(inside);
+			if (mask == 0) continue;
+
+			alignas(16) float lightX[4], lightY[4], lightDepth[4];
+			_mm_store_ps(lightX, viewPosition[0]);
+			_mm_store_ps(lightY, viewPosition[1]);
+			_mm_store_ps(lightDepth, depth);
+			for (int lane = 0; lane < 4; lane++) {
+				if (mask & (1 << lane))
+					addInView(lightX[lane], lightY[lane], lightDepth[lane], lights.radius[i + lane], (uint32_t)(i + lane));
+			}
+		}
+#endif
+
+		gatherScalar(view, lights, i);
+		LightsInView = (int)inView.size();
+	}
+
+	//tile rect of every light crossing slice z, clipped to the sphere's widest cross section inside the slice
+	void countSlice(int z)
+	{
+		std::vector<Span>& spans = sliceSpans[z];
+		spans.clear();
+
+		const float slice0 = sliceDepth[z], slice1 = sliceDepth[z + 1];
+		for (uint32_t l = 0; l < inView.size(); l++) {
+			const ViewLight& light = inView[l];
+			if (z < light.firstSlice || z > light.lastSlice)
+				continue;
+
+			float depth0 = std::max(slice0, light.depth - light.radius);
+			float depth1 = std::min(slice1, light.depth + light.radius);
+			if (depth0 > depth1)
+				continue;
+
+			float halfWidth = light.radius;
+			if (light.depth < depth0 || light.depth > depth1) {
+				float offset = light.depth < depth0 ? depth0 - light.depth : light.depth - depth1;
+				halfWidth = std::sqrt(std::max(light.radius * light.radius - offset * offset, 0.0f));
+			}
+
+			float minX, maxX, minY, maxY;
+			screenRect(light.x, light.y, halfWidth, depth0, depth1, minX, maxX, minY, maxY);
+			if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+				continue;
+
+			Span span = { l, (uint16_t)tileOf(minX, GRID_X), (uint16_t)tileOf(maxX, GRID_X), (uint16_t)tileOf(minY, GRID_Y), (uint16_t)tileOf(maxY, GRID_Y) };
+			spans.push_back(span);
+			for (int y = span.y0; y <= span.y1; y++) {
+				uint32_t* row = &counts[(z * GRID_Y + y) * GRID_X];
+				for (int x = span.x0; x <= span.x1; x++)
+					row[x]++;
+			}
+		}
+	}
+
+	//spans run in light order, so every cluster lists its lights sorted and the output doesn't depend on the threads
+	void fillSlice(int z, const std::vector<uint32_t>& owners)
+	{
+		for (const Span& span : sliceSpans[z]) {
+			uint32_t owner = owners[inView[span.light].index];
+			for (int y = span.y0; y <= span.y1; y++) {
+				int rowStart = (z * GRID_Y + y) * GRID_X;
+				for (int x = span.x0; x <= span.x1; x++) {
+					int cluster = rowStart + x;
+					if (cursors[cluster] < grid[cluster * 2] + grid[cluster * 2 + 1])
+						indices[cursors[cluster]++] = owner;
+				}
+			}
+		}
+	}
+};
+
+#endif
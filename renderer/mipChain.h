@@ -0,0 +1,126 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE 1
+#include <emmintrin.h>
+#endif
+
+//8 bit texture with all of its mip levels packed back to back in one allocation
+//built on a worker thread so the GL thread can upload every level without glGenerateMipmap
+struct MipLevel {
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+};
+
+struct MipChain {
+	int channels = 0;
+	std::vector<MipLevel> levels;
+	std::vector<unsigned char> bytes;
+
+	const unsigned char* LevelData(size_t level) const { return bytes.data() + levels[level].offset; }
+	unsigned char* LevelData(size_t level) { return bytes.data() + levels[level].offset; }
+};
+
+//level starts are kept 8 byte aligned so the unpack alignment only depends on the row size
+const size_t MIP_LEVEL_ALIGNMENT = 8;
+
+namespace mipDetail {
+	//2x2 box filter of one output row, x1/y1 are clamped so odd sizes reuse the last texel
+	inline void DownsampleRowScalar(const unsigned char* row0, const unsigned char* row1, unsigned char* out, int srcWidth, int dstWidth, int channels, int startX)
+	{
+		for (int x = startX; x < dstWidth; x++) {
+			int x0 = 2 * x;
+			int x1 = std::min(x0 + 1, srcWidth - 1);
+			for (int c = 0; c < channels; c++) {
+				int sum = row0[x0 * channels + c] + row0[x1 * channels + c] + row1[x0 * channels + c] + row1[x1 * channels + c];
+				out[x * channels + c] = (unsigned char)((sum + 2) >> 2);
+			}
+		}
+	}
+
+#ifdef MIP_CHAIN_SSE
+	//RGBA8: 4 source texels from each row -> 2 output texels per iteration, sums in 16 bit lanes
+	//returns how many output texels were written
+	inline int DownsampleRowRGBA8SSE(const unsigned char* row0, const unsigned char* row1, unsigned char* out, int dstWidth)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+
+		int x = 0;
+		for (; x + 2 <= dstWidth; x += 2) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+			//vertical sums, texels 0,1 and texels 2,3
+			__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+			//horizontal pairs: [t0 + t1, t2 + t3]
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, zero));
+		}
+		return x;
+	}
+#endif
+
+	inline void Downsample(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int channels)
+	{
+		size_t srcPitch = (size_t)srcWidth * channels;
+		size_t dstPitch = (size_t)dstWidth * channels;
+
+		for (int y = 0; y < dstHeight; y++) {
+			const unsigned char* row0 = src + (size_t)(2 * y) * srcPitch;
+			const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcPitch;
+			unsigned char* out = dst + (size_t)y * dstPitch;
+
+			int done = 0;
+#ifdef MIP_CHAIN_SSE
+			//the SIMD loop reads 4 texels per 2 outputs, only safe while 2x+1 stays inside the source row
+			if (channels == 4)
+				done = DownsampleRowRGBA8SSE(row0, row1, out, std::min(dstWidth, srcWidth / 2));
+#endif
+			DownsampleRowScalar(row0, row1, out, srcWidth, dstWidth, channels, done);
+		}
+	}
+}
+
+//copies level 0 and, when withMips is set, box filters it down to 1x1
+inline void BuildMipChain(const unsigned char* pixels, int width, int height, int channels, bool withMips, MipChain& chain)
+{
+	chain.channels = channels;
+	chain.levels.clear();
+
+	size_t total = 0;
+	int w = width, h = height;
+	while (true) {
+		MipLevel level = { w, h, total, (size_t)w * h * channels };
+		chain.levels.push_back(level);
+		total += (level.size + MIP_LEVEL_ALIGNMENT - 1) & ~(MIP_LEVEL_ALIGNMENT - 1);
+
+		if (!withMips || (w == 1 && h == 1))
+			break;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+
+	chain.bytes.resize(total);
+	std::memcpy(chain.LevelData(0), pixels, chain.levels[0].size);
+
+	for (size_t i = 1; i < chain.levels.size(); i++) {
+		const MipLevel& src = chain.levels[i - 1];
+		const MipLevel& dst = chain.levels[i];
+		mipDetail::Downsample(chain.LevelData(i - 1), src.width, src.height, chain.LevelData(i), dst.width, dst.height, channels);
+	}
+}
+
+#endif
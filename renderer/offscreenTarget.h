@@ -0,0 +1,71 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <algorithm>
+
+//colour + depth framebuffer standing in for the window's back buffer in headless runs
+class OffscreenTarget
+{
+public:
+	unsigned int FBO = 0;
+	int Width = 0;
+	int Height = 0;
+
+	bool Init(int width, int height)
+	{
+		Width = width;
+		Height = height;
+
+		glGenFramebuffers(1, &FBO);
+		glGenRenderbuffers(2, renderbuffers);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return complete;
+	}
+
+	void Bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, Width, Height);
+	}
+
+	//tightly packed RGB8, top row first like an image file
+	void ReadPixels(std::vector<unsigned char>& rgb) const
+	{
+		std::vector<unsigned char> bottomUp((size_t)Width * Height * 3);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, bottomUp.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		size_t pitch = (size_t)Width * 3;
+		rgb.resize(bottomUp.size());
+		for (int y = 0; y < Height; y++)
+			std::copy(bottomUp.begin() + (Height - 1 - y) * pitch, bottomUp.begin() + (Height - y) * pitch, rgb.begin() + y * pitch);
+	}
+
+	void Destroy()
+	{
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(2, renderbuffers);
+		FBO = 0;
+	}
+
+private:
+	unsigned int renderbuffers[2] = {};
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef PIXEL_UNPACK_RING_H
+#define PIXEL_UNPACK_RING_H
+
+#include <glad/glad.h>
+
+#include "glState.h"
+
+#include <cstring>
+#include <cstddef>
+
+//small ring of pixel unpack buffers for texture streaming
+//the CPU copy goes into a PBO and glTexImage2D sources from it, so the driver can do the transfer while we keep rendering
+//each slot is fenced after use and only rewritten once the GPU has consumed it
+class PixelUnpackRing
+{
+public:
+	static const int SLOT_COUNT = 3;
+
+	void Init(size_t initialSlotSize = 1 << 20)
+	{
+		glGenBuffers(SLOT_COUNT, buffers);
+		for (int i = 0; i < SLOT_COUNT; i++) {
+			GLState::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, initialSlotSize, nullptr, GL_STREAM_DRAW);
+			capacities[i] = initialSlotSize;
+			fences[i] = nullptr;
+		}
+		GLState::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	void Destroy()
+	{
+		for (int i = 0; i < SLOT_COUNT; i++) {
+			if (fences[i]) glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+		GLState::Get().DeleteBuffers(SLOT_COUNT, buffers);
+	}
+
+	//copies size bytes into the next slot and leaves it bound to GL_PIXEL_UNPACK_BUFFER
+	//until End, texture uploads take byte offsets into data instead of pointers
+	bool Begin(const void* data, size_t size)
+	{
+		if (fences[current]) {
+			if (glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+				Stalls++;
+				glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+			}
+			glDeleteSync(fences[current]);
+			fences[current] = nullptr;
+		}
+
+		GLState::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+		if (size > capacities[current]) {
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			capacities[current] = size;
+		}
+
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!mapped) {
+			GLState::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return false;
+		}
+		std::memcpy(mapped, data, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		return true;
+	}
+
+	//call after the uploads that read from the slot were issued
+	void End()
+	{
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GLState::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		current = (current + 1) % SLOT_COUNT;
+	}
+
+	//times Begin had to wait for the GPU to release a slot
+	int Stalls = 0;
+
+private:
+	GLuint buffers[SLOT_COUNT] = {};
+	size_t capacities[SLOT_COUNT] = {};
+	GLsync fences[SLOT_COUNT] = {};
+	int current = 0;
+};
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glState.h"
+#include "instanceBuffer.h"
+#include "../shaders/shader.h"
+#include "../core/linearArena.h"
+#include "../core/jobSystem.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+//everything one draw call needs, small enough to copy around by the thousand
+//the per draw transform points into storage that lives until the queue has been executed (the submitter's, or a Recorder arena)
+struct DrawPacket {
+	Shader* shader = nullptr;
+	GLuint vertexArray = 0;
+	GLuint textures[2] = { 0, 0 };		//material, unit 0 and 1 (diffuse, specular), 0 leaves the unit alone
+	GLenum mode = GL_TRIANGLES;
+	GLsizei count = 0;					//indices, or vertices for non indexed draws
+	GLenum indexType = 0;				//0 = glDrawArrays
+	GLsizei instanceCount = 0;			//0 = not instanced
+	const InstanceData* instance = nullptr;		//model, normalMatrix and DiffuseColor uniforms, null for instanced draws
+};
+
+//layers run in this order, each one is executed on its own so full screen passes can go in between
+enum RenderLayer : uint32_t {
+	RENDER_LAYER_SCENE,
+	RENDER_LAYER_LIGHT_SOURCES,
+	RENDER_LAYER_DEBUG,
+	RENDER_LAYER_COUNT
+};
+
+//per frame draw list: packets are submitted in any order, get a 64 bit key, are radix sorted and then issued
+//through GLState so only the state that actually differs between neighbours is touched
+//key, high bits first (bit positions in brackets):
+//  layer 4 [60] | translucent 1 [59] | opaque:      coarse depth 6 [53] | program 10 [43] | material 10 [33] | vertex array 10 [23] | fine depth 23 [0]
+//                                    | translucent: inverted depth 24 [35] | program 10 [25] | material 10 [15] | vertex array 10 [5] | unused 5 [0]
+//opaque packets go front to back in coarse (logarithmic) depth slices for early-Z and are grouped by state inside a slice,
+//translucent ones strictly back to front; names above 1023 alias, which only costs a redundant state change
+//big loops record as jobs (Record), each chunk into its own Recorder; GL is only touched by Execute
+class RenderQueue
+{
+	struct SortItem {
+		uint64_t key;
+		uint32_t index;
+	};
+
+public:
+	enum { DEPTH_SLICES = 64, RECORD_CHUNK = 1024 };
+
+	//one chunk's packets plus an arena for the data they point at (transforms built while recording)
+	class Recorder
+	{
+	public:
+		void Submit(const DrawPacket& packet, RenderLayer layer, float viewDepth, bool translucent = false)
+		{
+			SortItem item;
+			item.key = queue->makeKey(packet, layer, viewDepth, translucent);
+			item.index = (uint32_t)packets.size();
+			items.push_back(item);
+			packets.push_back(packet);
+		}
+
+		float ViewDepth(const glm::vec3& position) const { return queue->ViewDepth(position); }
+
+		//valid until the queue is cleared
+		template <typename T>
+		T* Allocate() { return arena.Allocate<T>(); }
+
+	private:
+		friend class RenderQueue;
+		const RenderQueue* queue = nullptr;
+		std::vector<DrawPacket> packets;
+		std::vector<SortItem> items;
+		LinearArena arena;
+	};
+
+	//fn(recorder, begin, end) submits the draws of items [begin, end)
+	typedef std::function<void(Recorder&, size_t, size_t)> RecordFunction;
+
+	//counted by Execute since the last Clear
+	int DrawCalls = 0;
+	int ProgramChanges = 0;
+	int MaterialChanges = 0;
+	int VertexArrayChanges = 0;
+	size_t UniformBytes = 0;
+	int RecordChunks = 0;				//since the last Clear, a Record call below RECORD_CHUNK items stays on the calling thread
+
+	void Clear()
+	{
+		packets.clear();
+		items.clear();
+		sorted = true;
+		recordersUsed = 0;
+		RecordChunks = 0;
+		DrawCalls = 0;
+		ProgramChanges = 0;
+		MaterialChanges = 0;
+		VertexArrayChanges = 0;
+		UniformBytes = 0;
+	}
+
+	//camera for this frame's depths, the planes match the projection so the slices cover the visible range
+	void SetView(const glm::mat4& view, float nearPlane, float farPlane)
+	{
+		this->view = view;
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		logDepthScale = 1.0f / std::log(farPlane / nearPlane);
+	}
+
+	//distance along the view direction, what the keys sort on
+	float ViewDepth(const glm::vec3& position) const
+	{
+		return -(view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z + view[3][2]);
+	}
+
+	void Submit(const DrawPacket& packet, RenderLayer layer, float viewDepth, bool translucent = false)
+	{
+		SortItem item;
+		item.key = makeKey(packet, layer, viewDepth, translucent);
+		item.index = (uint32_t)packets.size();
+		items.push_back(item);
+		packets.push_back(packet);
+		sorted = false;
+	}
+
+	//records count items in RECORD_CHUNK sized chunks spread over the JobSystem (the calling thread helps), then appends
+	//the chunks in order, so the result (and the sort, which is stable) is the same as one serial loop
+	void Record(size_t count, const RecordFunction& record)
+	{
+		if (count == 0)
+			return;
+
+		size_t chunks = (count + RECORD_CHUNK - 1) / RECORD_CHUNK;
+		size_t first = recordersUsed;
+		recordersUsed += chunks;
+		while (recorders.size() < recordersUsed)
+			recorders.emplace_back(new Recorder());
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			Recorder& recorder = *recorders[first + chunk];
+			recorder.queue = this;
+			recorder.packets.clear();
+			recorder.items.clear();
+			recorder.arena.Reset();
+		}
+
+		JobSystem::Get().ParallelFor(chunks, 1, [this, first, count, &record](size_t chunk, size_t) {
+			PROFILE_SCOPE("Record draws");
+			size_t begin = chunk * RECORD_CHUNK;
+			record(*recorders[first + chunk], begin, std::min(begin + (size_t)RECORD_CHUNK, count));
+		});
+		RecordChunks += (int)chunks;
+
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			const Recorder& recorder = *recorders[first + chunk];
+			uint32_t offset = (uint32_t)packets.size();
+			packets.insert(packets.end(), recorder.packets.begin(), recorder.packets.end());
+			for (SortItem item : recorder.items) {
+				item.index += offset;
+				items.push_back(item);
+			}
+		}
+		sorted = false;
+	}
+
+	size_t Count() const { return packets.size(); }
+
+	//LSD radix sort on the keys, 8 bits a pass; stable, so equal keys keep their submission order
+	void Sort()
+	{
+		if (sorted)
+			return;
+		sorted = true;
+
+		const size_t count = items.size();
+		size_t histograms[8][256];
+		std::memset(histograms, 0, sizeof(histograms));
+		for (const SortItem& item : items)
+			for (int digit = 0; digit < 8; digit++)
+				histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+
+		scratch.resize(count);
+		for (int digit = 0; digit < 8; digit++) {
+			size_t* histogram = histograms[digit];
+			//every key has the same byte here (unused layers, the high depth bits of a shallow scene), nothing moves
+			if (histogram[(items[0].key >> (digit * 8)) & 0xFF] == count)
+				continue;
+
+			size_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++) {
+				size_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+			for (const SortItem& item : items)
+				scratch[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+			items.swap(scratch);
+		}
+	}
+
+	//issues the sorted packets of one layer, the caller sets the per frame uniforms of the programs beforehand
+	void Execute(RenderLayer layer)
+	{
+		Sort();
+
+		const uint64_t layerKey = (uint64_t)layer << LAYER_SHIFT;
+		auto first = std::lower_bound(items.begin(), items.end(), layerKey,
+			[](const SortItem& item, uint64_t key) { return item.key < key; });
+
+		const UniformId modelId = UniformName("model");
+		const UniformId normalMatrixId = UniformName("normalMatrix");
+		const UniformId colorId = UniformName("DiffuseColor");
+
+		GLState& state = GLState::Get();
+		const DrawPacket* previous = nullptr;
+		bool hasModel = false, hasNormalMatrix = false, hasColor = false;
+		bool blending = false;
+
+		for (auto item = first; item != items.end() && (item->key >> LAYER_SHIFT) == layer; ++item) {
+			const DrawPacket& packet = packets[item->index];
+
+			bool translucent = ((item->key >> TRANSLUCENT_SHIFT) & 1) != 0;
+			if (translucent && !blending) {
+				state.Enable(GL_BLEND);
+				state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				state.DepthMask(GL_FALSE);
+				blending = true;
+			}
+
+			if (!previous || previous->shader != packet.shader) {
+				packet.shader->use();
+				hasModel = packet.shader->hasUniform(modelId);
+				hasNormalMatrix = packet.shader->hasUniform(normalMatrixId);
+				hasColor = packet.shader->hasUniform(colorId);
+				ProgramChanges++;
+			}
+			if (!previous || previous->textures[0] != packet.textures[0] || previous->textures[1] != packet.textures[1]) {
+				for (int unit = 0; unit < 2; unit++) {
+					if (!packet.textures[unit])
+						continue;
+					state.ActiveTexture(GL_TEXTURE0 + unit);
+					state.BindTexture(GL_TEXTURE_2D, packet.textures[unit]);
+				}
+				MaterialChanges++;
+			}
+			if (!previous || previous->vertexArray != packet.vertexArray) {
+				state.BindVertexArray(packet.vertexArray);
+				VertexArrayChanges++;
+			}
+
+			if (packet.instance) {
+				if (hasModel) {
+					packet.shader->setMat4(modelId, packet.instance->model);
+					UniformBytes += sizeof(glm::mat4);
+				}
+				if (hasNormalMatrix) {
+					packet.shader->setMat3(normalMatrixId, packet.instance->normalMatrix);
+					UniformBytes += sizeof(glm::mat3);
+				}
+				if (hasColor) {
+					packet.shader->setVec3(colorId, packet.instance->color);
+					UniformBytes += sizeof(glm::vec3);
+				}
+			}
+
+			if (packet.indexType) {
+				if (packet.instanceCount)
+					glDrawElementsInstanced(packet.mode, packet.count, packet.indexType, 0, packet.instanceCount);
+				else
+					glDrawElements(packet.mode, packet.count, packet.indexType, 0);
+			}
+			else {
+				if (packet.instanceCount)
+					glDrawArraysInstanced(packet.mode, 0, packet.count, packet.instanceCount);
+				else
+					glDrawArrays(packet.mode, 0, packet.count);
+			}
+			DrawCalls++;
+			previous = &packet;
+		}
+
+		if (blending) {
+			state.DepthMask(GL_TRUE);
+			state.Disable(GL_BLEND);
+		}
+	}
+
+private:
+	enum {
+		LAYER_SHIFT = 60, TRANSLUCENT_SHIFT = 59, STATE_BITS = 10,
+		OPAQUE_SLICE_SHIFT = 53, OPAQUE_STATE_SHIFT = 23,
+		TRANSLUCENT_DEPTH_SHIFT = 35, TRANSLUCENT_STATE_SHIFT = 5
+	};
+	//every field sits directly on the one below it, a changed width has to move the shifts with it
+	static_assert(OPAQUE_SLICE_SHIFT + 6 == TRANSLUCENT_SHIFT && OPAQUE_STATE_SHIFT + 3 * STATE_BITS == OPAQUE_SLICE_SHIFT, "opaque key fields overlap");
+	static_assert(TRANSLUCENT_DEPTH_SHIFT + 24 == TRANSLUCENT_SHIFT && TRANSLUCENT_STATE_SHIFT + 3 * STATE_BITS == TRANSLUCENT_DEPTH_SHIFT, "translucent key fields overlap");
+
+	std::vector<DrawPacket> packets;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	bool sorted = true;
+
+	//owned, arenas hand out pointers the packets keep until Clear
+	std::vector<std::unique_ptr<Recorder>> recorders;
+	size_t recordersUsed = 0;
+
+	glm::mat4 view = glm::mat4(1.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	float logDepthScale = 1.0f;
+
+	uint64_t makeKey(const DrawPacket& packet, RenderLayer layer, float viewDepth, bool translucent) const
+	{
+		const uint64_t stateMask = (1u << STATE_BITS) - 1;
+		uint64_t program = (packet.shader ? packet.shader->ID : 0) & stateMask;
+		uint64_t material = (packet.textures[0] * 31u + packet.textures[1]) & stateMask;
+		uint64_t vertexArray = packet.vertexArray & stateMask;
+		uint64_t state = (program << (2 * STATE_BITS)) | (material << STATE_BITS) | vertexArray;
+
+		float linear = (std::min(std::max(viewDepth, nearPlane), farPlane) - nearPlane) / (farPlane - nearPlane);
+		uint64_t key = (uint64_t)layer << LAYER_SHIFT;
+
+		if (translucent) {
+			uint64_t inverted = (uint64_t)((1.0f - linear) * 16777215.0f);
+			return key | (1ull << TRANSLUCENT_SHIFT) | (inverted << TRANSLUCENT_DEPTH_SHIFT) | (state << TRANSLUCENT_STATE_SHIFT);
+		}
+
+		//slices grow with distance like the depth buffer's precision shrinks, so near objects are ordered finely
+		float logDepth = std::log(std::max(viewDepth, nearPlane) / nearPlane) * logDepthScale;
+		uint64_t slice = (uint64_t)std::min(logDepth * DEPTH_SLICES, (float)(DEPTH_SLICES - 1));
+		uint64_t fine = (uint64_t)(linear * 8388607.0f);
+		return key | (slice << OPAQUE_SLICE_SHIFT) | (state << OPAQUE_STATE_SHIFT) | fine;
+	}
+};
+
+#endif
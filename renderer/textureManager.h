@@ -0,0 +1,258 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/glad.h>
+
+#include "../core/threadPool.h"
+#include "../core/mpscQueue.h"
+#include "../libs/stb_image.h"
+#include "mipChain.h"
+#include "pixelUnpackRing.h"
+#include "compressedTexture.h"
+#include "glExtensions.h"
+#include "glState.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+//EXT_texture_compression_s3tc, not part of core GL so the loader may not define them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+//GL formats for a tightly packed 8 bit image with the given channel count
+struct TextureFormat {
+	GLint internalFormat;
+	GLenum format;
+};
+
+inline TextureFormat TextureFormatForChannels(int channels)
+{
+	switch (channels) {
+	case 1: return { GL_R8, GL_RED };
+	case 2: return { GL_RG8, GL_RG };
+	case 3: return { GL_RGB8, GL_RGB };
+	default: return { GL_RGBA8, GL_RGBA };
+	}
+}
+
+//largest GL_UNPACK_ALIGNMENT the rows satisfy, 3 channel images with odd widths need 1
+inline GLint UnpackAlignmentForRow(size_t rowBytes)
+{
+	if (rowBytes % 8 == 0) return 8;
+	if (rowBytes % 4 == 0) return 4;
+	if (rowBytes % 2 == 0) return 2;
+	return 1;
+}
+
+//loads textures off the render thread
+//Load returns a usable texture name right away, holding a 1x1 placeholder until the decode finishes
+//workers decode with stb_image (and build the mip chain) and push it onto an MPSC queue that the GL thread drains in ProcessUploads
+//uploads stream through a PBO ring and keep the channel count of the source image
+//with compressedCache on, decoded images are also cooked to <image>.ctex (BC1/BC3) and later loads map that instead
+class TextureManager
+{
+public:
+	//cpuMipmaps builds the mip chain on the workers instead of calling glGenerateMipmap on the GL thread
+	void Init(unsigned int workerCount = 0, bool cpuMipmaps = true, bool compressedCache = true)
+	{
+		this->cpuMipmaps = cpuMipmaps;
+		this->compressedCache = compressedCache && HasGLExtension("GL_EXT_texture_compression_s3tc");
+		workers.Start(workerCount, "Texture");
+		uploadRing.Init();
+	}
+
+	void Destroy()
+	{
+		//let in flight decodes finish so nothing writes into the queue after this
+		workers.Shutdown();
+
+		DecodedImage image;
+		while (decoded.TryPop(image)) {}
+		uploadRing.Destroy();
+
+		if (!textures.empty())
+			GLState::Get().DeleteTextures((GLsizei)textures.size(), textures.data());
+		textures.clear();
+		pending = 0;
+		textureMemory = 0;
+	}
+
+	GLuint Load(const std::string& path, bool flipVertically = true, GLenum wrap = GL_MIRRORED_REPEAT)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, texture);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		//owned from here on, whichever path fills it, so Destroy frees cooked textures too
+		textures.push_back(texture);
+
+		if (compressedCache && loadCompressed(path, flipVertically))
+			return texture;
+
+		//neutral grey until the real image is uploaded
+		const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		pending++;
+
+		bool withMips = cpuMipmaps;
+		bool cook = compressedCache;
+		workers.Submit([this, path, texture, flipVertically, withMips, cook]() {
+			PROFILE_SCOPE("Decode texture");
+			DecodedImage image;
+			image.texture = texture;
+			image.path = path;
+
+			int width, height, channels;
+			stbi_set_flip_vertically_on_load_thread(flipVertically);
+			unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+			if (pixels) {
+				BuildMipChain(pixels, width, height, channels, withMips, image.chain);
+
+				//picked up by the next run, this one keeps the uncompressed upload
+				FileStamp stamp;
+				if (cook && GetFileStamp(path, stamp))
+					CookCompressedTexture(path + ".ctex", pixels, width, height, channels, flipVertically, stamp);
+
+				stbi_image_free(pixels);
+			}
+			decoded.Push(std::move(image));
+		});
+
+		return texture;
+	}
+
+	//uploads finished decodes until budgetMs is used up (at least one per call so a big image can't starve)
+	//returns the number of bytes handed to GL
+	size_t ProcessUploads(double budgetMs = 2.0)
+	{
+		PROFILE_SCOPE("Texture uploads");
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t bytes = 0;
+		bool uploadedAny = false;
+
+		DecodedImage image;
+		while (true) {
+			if (uploadedAny) {
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				if (elapsed.count() >= budgetMs)
+					break;
+			}
+			if (!decoded.TryPop(image))
+				break;
+
+			pending--;
+			uploadedAny = true;
+
+			if (image.chain.levels.empty()) {
+				std::cout << "Failed to load texture " << image.path << std::endl;
+				continue;
+			}
+
+			bytes += upload(image);
+			image.chain = MipChain();
+		}
+
+		return bytes;
+	}
+
+	//blocks until every requested texture is uploaded, for runs that need the final images from frame one
+	void FinishPending()
+	{
+		while (pending > 0) {
+			if (ProcessUploads(1e9) == 0)
+				std::this_thread::yield();
+		}
+	}
+
+	//textures still showing the placeholder
+	int PendingCount() const { return pending; }
+	int UploadStalls() const { return uploadRing.Stalls; }
+	//bytes of texel data handed to GL across all live textures (placeholders excluded)
+	size_t TextureMemory() const { return textureMemory; }
+
+private:
+	struct DecodedImage {
+		GLuint texture = 0;
+		MipChain chain;		//empty when the decode failed
+		std::string path;
+	};
+
+	ThreadPool workers;
+	MpscQueue<DecodedImage> decoded;
+	PixelUnpackRing uploadRing;
+	std::vector<GLuint> textures;
+	int pending = 0;	//only touched on the GL thread
+	bool cpuMipmaps = true;
+	bool compressedCache = false;
+	size_t textureMemory = 0;
+
+	//uploads a valid, up to date .ctex straight from the mapping into the bound texture
+	bool loadCompressed(const std::string& path, bool flipVertically)
+	{
+		FileStamp stamp;
+		CompressedTextureFile file;
+		if (!GetFileStamp(path, stamp) || !file.Open(path + ".ctex", &stamp, flipVertically ? 1 : 0))
+			return false;
+
+		GLenum internalFormat = file.Format() == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		for (int i = 0; i < file.LevelCount(); i++) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, file.LevelWidth(i), file.LevelHeight(i), 0, (GLsizei)file.LevelSize(i), file.LevelData(i));
+			textureMemory += file.LevelSize(i);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.LevelCount() - 1);
+		return true;
+	}
+
+	size_t upload(const DecodedImage& image)
+	{
+		const MipChain& chain = image.chain;
+		TextureFormat format = TextureFormatForChannels(chain.channels);
+
+		GLState::Get().BindTexture(GL_TEXTURE_2D, image.texture);
+
+		//grey / grey+alpha images sample like the RGBA they replace
+		if (chain.channels == 1) {
+			const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+		else if (chain.channels == 2) {
+			const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+
+		bool fromBuffer = uploadRing.Begin(chain.bytes.data(), chain.bytes.size());
+		for (size_t i = 0; i < chain.levels.size(); i++) {
+			const MipLevel& level = chain.levels[i];
+			const void* source = fromBuffer ? (const void*)level.offset : (const void*)chain.LevelData(i);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, UnpackAlignmentForRow((size_t)level.width * chain.channels));
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, format.internalFormat, level.width, level.height, 0, format.format, GL_UNSIGNED_BYTE, source);
+		}
+		if (fromBuffer)
+			uploadRing.End();
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (chain.levels.size() == 1)
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+		textureMemory += chain.levels.size() == 1 ? chain.bytes.size() * 4 / 3 : chain.bytes.size();
+		return chain.bytes.size();
+	}
+};
+
+#endif
@@ -1,7 +1,7 @@
 #version 330 core
-in vec3 fColor;
+in vec4 fColor;
 out vec4 FragColor;
 
 void main() {
-    FragColor = vec4(fColor, 1.0);
+    FragColor = fColor;
 }
\ No newline at end of file
@@ -1,11 +1,11 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 1) in vec4 aColor;
 
 uniform mat4 view;
 uniform mat4 projection;
 
-out vec3 fColor;
+out vec4 fColor;
 
 void main() {
     gl_Position = projection * view * vec4(aPos, 1.0);
@@ -0,0 +1,35 @@
+#version 330 core
+layout (points) in;
+layout (line_strip, max_vertices = 4) out;
+
+in vec3 vNormal[];
+out vec4 fColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform bool showNormals;
+uniform bool showLightDirs;
+// direction the light travels, lines point back towards it
+uniform vec3 lightDirection;
+
+void emitLine(vec3 from, vec3 to, vec4 color)
+{
+    mat4 viewProjection = projection * view;
+    fColor = color;
+    gl_Position = viewProjection * vec4(from, 1.0);
+    EmitVertex();
+    gl_Position = viewProjection * vec4(to, 1.0);
+    EmitVertex();
+    EndPrimitive();
+}
+
+void main()
+{
+    vec3 position = gl_in[0].gl_Position.xyz;
+
+    if (showNormals)
+        emitLine(position, position + vNormal[0] * 0.2, vec4(0.0, 0.0, 1.0, 1.0));
+    if (showLightDirs)
+        emitLine(position, position - normalize(lightDirection) * 0.3, vec4(0.0, 1.0, 0.0, 1.0));
+}
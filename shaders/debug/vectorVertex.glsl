@@ -0,0 +1,26 @@
+#version 330 core
+// one point per mesh vertex, the geometry shader grows the lines out of it
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+#ifdef INSTANCED
+// same per instance attributes as vertex.glsl, see renderer/instanceBuffer.h
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in mat3 aNormalMatrix;
+#else
+uniform mat4 model;
+uniform mat3 normalMatrix;
+#endif
+
+out vec3 vNormal;
+
+void main()
+{
+#ifdef INSTANCED
+    mat4 model = aModel;
+    mat3 normalMatrix = aNormalMatrix;
+#endif
+    // world space, view/projection are applied per line end
+    gl_Position = model * vec4(aPos, 1.0);
+    vNormal = normalize(normalMatrix * aNormal);
+}
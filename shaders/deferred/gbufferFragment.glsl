@@ -0,0 +1,27 @@
+#version 330 core
+// G-buffer layout, see renderer/gBuffer.h
+layout (location = 0) out vec4 gAlbedoSpecular;	// rgb albedo, a specular intensity
+layout (location = 1) out vec2 gNormal;			// octahedral normal, remapped to 0..1
+
+in vec2 TexCoord;
+in vec3 Normal;
+
+struct Material {
+	sampler2D diffuse;
+	sampler2D specular;
+	float shininess;
+};
+
+uniform Material material;
+
+#include "../octahedral.glsl"
+
+void main()
+{
+#ifdef SPECULAR_MAP
+	gAlbedoSpecular = vec4(texture(material.diffuse, TexCoord).rgb, texture(material.specular, TexCoord).r);
+#else
+	gAlbedoSpecular = vec4(texture(material.diffuse, TexCoord).rgb, 0.0);
+#endif
+	gNormal = EncodeOctahedral(normalize(Normal)) * 0.5 + 0.5;
+}
@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+// material.shininess of the forward path, the scene has a single material
+uniform float shininess;
+
+#include "../lights.glsl"
+#include "../phong.glsl"
+#include "../octahedral.glsl"
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	// nothing was drawn here, keep the clear colour
+	if (depth == 1.0)
+		discard;
+
+	vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+	vec3 normal = DecodeOctahedral(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);
+
+	// world position back from the window position and depth
+	vec3 ndc = vec3(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0;
+	vec4 world = inverseViewProjection * vec4(ndc, 1.0);
+	vec3 fragPos = world.xyz / world.w;
+	vec3 viewDir = normalize(viewPos - fragPos);
+
+	Surface surface = Surface(albedoSpecular.rgb, vec3(albedoSpecular.a), shininess);
+	FragColor = vec4(ShadeSurface(surface, normal, fragPos, viewDir, vec4(gl_FragCoord.xy, depth, 1.0)), 1.0);
+
+	// the forward passes after this one (light cubes, debug lines) depth test against the scene
+	gl_FragDepth = depth;
+}
@@ -0,0 +1,8 @@
+#version 330 core
+// one triangle covering the screen, no vertex buffer: ids 0, 1, 2 become (-1,-1), (3,-1), (-1,3)
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
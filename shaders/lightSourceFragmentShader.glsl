@@ -1,9 +1,14 @@
 #version 330 core
 out vec4 FragColor;
 
+#ifdef INSTANCED
+in vec3 InstanceColor;
+#define DiffuseColor InstanceColor
+#else
 uniform vec3 DiffuseColor;
+#endif
 
 void main()
 {
    FragColor = vec4(DiffuseColor, 1.0f);
-}  
\ No newline at end of file
+}  
@@ -0,0 +1,62 @@
+// shared light block, mirrored on the CPU by LightBlock (renderer/lightBlock.h)
+// every member is laid out to fill whole vec4 slots under std140, point lights live in a texture buffer
+// and each fragment only visits the ones its cluster lists (renderer/lightClusters.h)
+
+struct DirLight {
+	vec3 direction;
+	float pad0;
+
+	vec3 ambient;
+	float pad1;
+	vec3 diffuse;
+	float pad2;
+	vec3 specular;
+	float pad3;
+};
+
+struct PointLight {
+	vec3 position;
+	float constant;
+
+	vec3 ambient;
+	float linear;
+	vec3 diffuse;
+	float quadratic;
+	vec3 specular;
+	float range; // falloff window reaches zero here, 0 = disabled
+};
+
+layout (std140) uniform LightBlock {
+	ivec4 lightCounts; // x = point light count
+	DirLight dirLight;
+};
+
+// 4 texels per light, same order as the PointLight members
+uniform samplerBuffer pointLightData;
+
+PointLight FetchPointLight(int index)
+{
+	vec4 t0 = texelFetch(pointLightData, index * 4);
+	vec4 t1 = texelFetch(pointLightData, index * 4 + 1);
+	vec4 t2 = texelFetch(pointLightData, index * 4 + 2);
+	vec4 t3 = texelFetch(pointLightData, index * 4 + 3);
+	return PointLight(t0.xyz, t0.w, t1.xyz, t1.w, t2.xyz, t2.w, t3.xyz, t3.w);
+}
+
+// froxel grid: x/y are screen tiles, z slices view depth exponentially between near and far
+// clusterGrid holds (first index, light count) per cluster, the indices point into pointLightData
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform vec4 clusterScale;		// tiles per pixel (xy), slices per log depth (z), slice of depth 1 (w)
+uniform vec2 clusterDepth;		// near, far
+
+int ClusterIndex(vec4 fragCoord)
+{
+	// window depth back to linear view depth, the depth range is the default 0..1
+	float ndcDepth = fragCoord.z * 2.0 - 1.0;
+	float viewDepth = 2.0 * clusterDepth.x * clusterDepth.y / (clusterDepth.y + clusterDepth.x - ndcDepth * (clusterDepth.y - clusterDepth.x));
+
+	ivec3 cluster = ivec3(fragCoord.xy * clusterScale.xy, log(viewDepth) * clusterScale.z - clusterScale.w);
+	cluster = clamp(cluster, ivec3(0), ivec3(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1));
+	return (cluster.z * CLUSTER_GRID_Y + cluster.y) * CLUSTER_GRID_X + cluster.x;
+}
@@ -0,0 +1,21 @@
+// unit normals folded onto the octahedron and flattened to two components in -1..1,
+// stored as RG16 the error stays under a hundredth of a degree at two thirds the size of an RGB16F normal
+
+vec2 OctahedralWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	return n.z >= 0.0 ? n.xy : OctahedralWrap(n.xy);
+}
+
+vec3 DecodeOctahedral(vec2 f)
+{
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
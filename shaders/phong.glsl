@@ -0,0 +1,119 @@
+// Phong lighting shared by the forward (fragmentLight.glsl) and deferred (deferred/lightingFragment.glsl) paths
+// include after lights.glsl, the caller samples the surface once and ShadeSurface adds up every light reaching it
+// compiled per light set (shaders/shaderVariants.h), only what is defined here gets evaluated:
+//   DIR_LIGHT, POINT_LIGHTS (the cluster loop), SPOT_LIGHT, SPECULAR_MAP, CLUSTER_HEATMAP
+
+struct Surface {
+	vec3 albedo;
+	vec3 specular;
+	float shininess;
+};
+
+#ifdef SPOT_LIGHT
+struct SpotLight {
+	vec3 position;
+	vec3 direction;
+	float cutOff;
+	float outerCutOff;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+uniform SpotLight spotLight;
+#endif
+
+vec3 ApplyPhong(vec3 lightDir, vec3 normal, vec3 viewDir, Surface surface, vec3 lightAmbient, vec3 lightDiffuse, vec3 lightSpecular, float attenuation, float intensity)
+{
+	lightDir = normalize(lightDir);
+	vec3 reflectDir = reflect(-lightDir, normal);
+
+	// Diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	// Combine all
+	vec3 ambient  = lightAmbient  * surface.albedo;
+	vec3 diffuse  = lightDiffuse  * diff * surface.albedo;
+
+	ambient  *= attenuation;
+	diffuse  *= attenuation * intensity;
+
+#ifdef SPECULAR_MAP
+	// Specular
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+	vec3 specular = lightSpecular * spec * surface.specular;
+	specular *= attenuation * intensity;
+
+	return ambient + diffuse + specular;
+#else
+	return ambient + diffuse;
+#endif
+}
+
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 normal, vec3 viewDir){
+	vec3 lightDir = -light.direction;
+	return ApplyPhong(lightDir, normal, viewDir, surface, light.ambient, light.diffuse, light.specular, 1.0, 1.0);
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = light.position - fragPos;
+	float distance = length(lightDir);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	// windowed to reach zero at the range the clusters were built with, so the tails of lights a cluster leaves out don't go missing
+	float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+	attenuation *= window * window;
+
+	return ApplyPhong(lightDir, normal, viewDir, surface, light.ambient, light.diffuse, light.specular, attenuation, 1.0);
+}
+
+#ifdef SPOT_LIGHT
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir){
+	vec3 lightDir = normalize(light.position - fragPos);
+
+	vec3 spotDir = normalize(-light.direction);
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	//attenuation
+	float distance = length(lightDir);
+	float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
+
+
+	return ApplyPhong(lightDir, normal, viewDir, surface, light.ambient, light.diffuse, light.specular, attenuation, intensity);
+	
+}
+#endif
+
+// directional light, the point lights of the fragment's cluster and the spot light, whichever are compiled in
+// fragCoord is gl_FragCoord, or the pixel and its G-buffer depth in the deferred pass
+vec3 ShadeSurface(Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir, vec4 fragCoord)
+{
+	vec3 result = vec3(0.0);
+#ifdef DIR_LIGHT
+	result += CalcDirLight(dirLight, surface, normal, viewDir);
+#endif
+
+#if defined(POINT_LIGHTS) || defined(CLUSTER_HEATMAP)
+	uvec2 cluster = texelFetch(clusterGrid, ClusterIndex(fragCoord)).xy;
+#endif
+#ifdef POINT_LIGHTS
+	for(uint i = 0u; i < cluster.y; i++)
+	{
+		PointLight light = FetchPointLight(int(texelFetch(clusterLightIndices, int(cluster.x + i)).r));
+		if (light.range == 0.0)
+			continue;
+		result += CalcPointLight(light, surface, normal, fragPos, viewDir);
+	}
+#endif
+#ifdef SPOT_LIGHT
+	result += CalcSpotLight(spotLight, surface, normal, fragPos, viewDir);
+#endif
+
+#ifdef CLUSTER_HEATMAP
+	// lights per cluster, blue (none) through green to red (32 or more)
+	float heat = float(cluster.y) / 16.0;
+	result = mix(result, clamp(vec3(heat - 1.0, 1.0 - abs(heat - 1.0), 1.0 - heat), 0.0, 1.0), 0.6);
+#endif
+	return result;
+}
@@ -0,0 +1,250 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include "../renderer/glExtensions.h"
+#include "../core/mappedFile.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+//ARB_get_program_binary (core in 4.1) and KHR_parallel_shader_compile, looked up at runtime since the loader targets 3.3
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNPROGRAMCACHEGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNPROGRAMCACHEPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNPROGRAMCACHEPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNPROGRAMCACHEMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+//.glbin program binary: a fixed header followed by whatever glGetProgramBinary returned
+//they live in the cache directory given to Init, never next to the sources; one file per program: the name hashes the stage paths and the injected defines, so every variant has its own file
+//the key in the header hashes the preprocessed sources (includes and defines expanded) and the driver strings, an edited
+//shader or a driver update no longer matches it and the file is recompiled and overwritten in place, as is a binary
+//the driver refuses
+//bump PROGRAM_CACHE_VERSION whenever the header changes
+
+const uint32_t PROGRAM_CACHE_MAGIC = 0x4E494250u; //"PBIN"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+	uint64_t key;
+	uint64_t driver;		//hash of vendor, renderer and version strings
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 32, "ProgramCacheHeader layout is part of the file format");
+
+//FNV-1a, 64 bit so unrelated programs don't end up sharing a file
+inline uint64_t HashProgramBytes(const void* bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* data = static_cast<const unsigned char*>(bytes);
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	return hash;
+}
+
+//binary cache every Shader links through, plus the driver side parallel compile switch
+//without the extensions (or before Init) Load always misses, Store does nothing and programs count as complete
+class ProgramCache
+{
+public:
+	static ProgramCache& Get()
+	{
+		static ProgramCache instance;
+		return instance;
+	}
+
+	int Hits = 0;
+	int Misses = 0;
+	int Rejected = 0;		//binaries the driver refused, e.g. after an update that kept its version string
+	int Stored = 0;
+	int WriteFailures = 0;	//binaries that couldn't be written to the cache directory
+
+	//loader is the same proc loader glad was initialised with; directory is where the binaries go, created if missing,
+	//an empty one turns the disk cache off but still allows parallel compiles
+	void Init(GLADloadproc loader, const std::string& directory)
+	{
+		parallel = false;
+		if (HasGLExtension("GL_KHR_parallel_shader_compile")) {
+			PFNPROGRAMCACHEMAXSHADERCOMPILERTHREADSPROC maxCompilerThreads = (PFNPROGRAMCACHEMAXSHADERCOMPILERTHREADSPROC)loader("glMaxShaderCompilerThreadsKHR");
+			if (maxCompilerThreads) {
+				//0xFFFFFFFF lets the driver pick how many threads
+				maxCompilerThreads(0xFFFFFFFFu);
+				parallel = true;
+			}
+		}
+
+		binaries = false;
+		this->directory = directory;
+		if (!directory.empty() && !MakeDirectory(directory)) {
+			std::cerr << "Program cache: can't create " << directory << ", binaries stay off" << std::endl;
+			this->directory.clear();
+		}
+		if (!this->directory.empty() && HasGLExtension("GL_ARB_get_program_binary")) {
+			getProgramBinary = (PFNPROGRAMCACHEGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+			programBinary = (PFNPROGRAMCACHEPROGRAMBINARYPROC)loader("glProgramBinary");
+			programParameteri = (PFNPROGRAMCACHEPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+
+			//a driver may expose the entry points and still support no format at all
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			binaries = formats > 0 && getProgramBinary && programBinary && programParameteri;
+		}
+
+		driver = 14695981039346656037ull;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+			const char* value = reinterpret_cast<const char*>(glGetString(name));
+			if (value)
+				driver = HashProgramBytes(value, std::strlen(value) + 1, driver);
+		}
+	}
+
+	bool BinariesEnabled() const { return binaries; }
+	bool ParallelCompile() const { return parallel; }
+
+	uint64_t Key(const std::string* sources, size_t count) const
+	{
+		uint64_t hash = driver;
+		for (size_t i = 0; i < count; i++)
+			hash = HashProgramBytes(sources[i].c_str(), sources[i].size() + 1, hash);
+		return hash;
+	}
+
+	const std::string& Directory() const { return directory; }
+
+	//<directory>/<fragment file name>.<program>.glbin, program hashing the stage paths and defines but not the sources,
+	//which only the header key covers; geometryPath may be null
+	std::string PathFor(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::string& defines) const
+	{
+		uint64_t program = 14695981039346656037ull;
+		for (const char* path : { vertexPath, fragmentPath, geometryPath }) {
+			const char* name = path ? path : "";
+			program = HashProgramBytes(name, std::strlen(name) + 1, program);
+		}
+		program = HashProgramBytes(defines.c_str(), defines.size() + 1, program);
+
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), ".%016llx.glbin", (unsigned long long)program);
+		std::string fragment(fragmentPath);
+		size_t slash = fragment.find_last_of("/\\");
+		return directory + "/" + (slash == std::string::npos ? fragment : fragment.substr(slash + 1)) + suffix;
+	}
+
+	//true when program was linked from the cached binary, false means it has to be compiled
+	bool Load(GLuint program, const std::string& path, uint64_t key)
+	{
+		if (!binaries)
+			return false;
+
+		MappedFile file;
+		ProgramCacheHeader header;
+		if (!file.Open(path) || file.Size() < sizeof(header)) {
+			Misses++;
+			return false;
+		}
+		std::memcpy(&header, file.Data(), sizeof(header));
+		if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != key || header.driver != driver ||
+			header.binaryLength == 0 || file.Size() - sizeof(header) < header.binaryLength) {
+			Misses++;
+			return false;
+		}
+
+		programBinary(program, (GLenum)header.binaryFormat, file.Data() + sizeof(header), (GLsizei)header.binaryLength);
+		GLint linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			Rejected++;
+			return false;
+		}
+		Hits++;
+		return true;
+	}
+
+	//before glLinkProgram, some drivers only keep a retrievable binary when asked
+	void PrepareLink(GLuint program) const
+	{
+		if (binaries)
+			programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	//after a successful link
+	void Store(GLuint program, const std::string& path, uint64_t key)
+	{
+		if (!binaries)
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<char> binary((size_t)length);
+		GLsizei written = 0;
+		GLenum format = 0;
+		getProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0)
+			return;
+
+		ProgramCacheHeader header;
+		std::memset(&header, 0, sizeof(header));
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.version = PROGRAM_CACHE_VERSION;
+		header.binaryFormat = format;
+		header.binaryLength = (uint32_t)written;
+		header.key = key;
+		header.driver = driver;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (file) {
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(binary.data(), written);
+		}
+		if (file) {
+			Stored++;
+			return;
+		}
+		//the first failure is reported, the rest only counted
+		if (WriteFailures++ == 0)
+			std::cerr << "Program cache: can't write " << path << std::endl;
+	}
+
+	//with parallel compiles the driver links in the background, this polls without waiting for it
+	bool IsComplete(GLuint program) const
+	{
+		if (!parallel)
+			return true;
+		GLint complete = 0;
+		glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete != 0;
+	}
+
+private:
+	bool binaries = false;
+	bool parallel = false;
+	uint64_t driver = 0;
+	std::string directory;
+	PFNPROGRAMCACHEGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+	PFNPROGRAMCACHEPROGRAMBINARYPROC programBinary = nullptr;
+	PFNPROGRAMCACHEPROGRAMPARAMETERIPROC programParameteri = nullptr;
+};
+
+#endif
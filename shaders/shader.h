@@ -4,95 +4,86 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "programCache.h"
+#include "../renderer/glState.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
-class Shader
+//FNV-1a hash of a uniform name, constexpr so call sites can hash their names at compile time
+constexpr unsigned int HashUniformName(const char* name, unsigned int hash = 2166136261u)
 {
-public: 
-
-	unsigned int ID;
+	return *name == '\0' ? hash : HashUniformName(name + 1, (hash ^ (unsigned char)*name) * 16777619u);
+}
 
-	Shader(const char* vertexPath, const char* fragmentPath) {
-		//1.retrieve source code from filepath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-
-			vShaderFile.close();
-			fShaderFile.close();
+//second, independent hash (djb2, xor variant) the table compares as well, so two names whose FNV hashes
+//collide still resolve to their own uniforms
+constexpr unsigned int CheckUniformName(const char* name, unsigned int hash = 5381u)
+{
+	return *name == '\0' ? hash : CheckUniformName(name + 1, (hash * 33u) ^ (unsigned char)*name);
+}
 
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+//precomputed uniform handle, setters taking this skip string building and driver queries
+struct UniformId
+{
+	unsigned int hash;
+	unsigned int check;
 
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+	constexpr UniformId(unsigned int h, unsigned int c) : hash(h), check(c) {}
+};
 
-		//2.Compile Shaders
-		unsigned int vertex, fragment;
-		int success;
-		char infoLog[512];
+constexpr UniformId UniformName(const char* name)
+{
+	return UniformId(HashUniformName(name), CheckUniformName(name));
+}
 
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
+class Shader
+{
+public: 
 
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
+	unsigned int ID;
+	bool LoadedFromCache = false;
 
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
+	enum class Build { Blocking, Async };
 
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
+	//defines are injected right after the #version line, e.g. "#define MAX_POINT_LIGHTS 64\n"
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "") {
+		build(vertexPath, fragmentPath, nullptr, defines, Build::Blocking);
+	}
 
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		glLinkProgram(ID);
+	//Async returns while the driver may still be compiling (KHR_parallel_shader_compile), use() only once isReady()
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines, Build mode) {
+		build(vertexPath, fragmentPath, nullptr, defines, mode);
+	}
 
-		glGetProgramiv(ID, GL_LINK_STATUS, &success);
-		if (!success)
-		{
-			glGetProgramInfoLog(ID, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-		}
+	//with a geometry stage, defines are not optional here so a three path call can't be read as vertex/fragment/defines
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::string& defines) {
+		build(vertexPath, fragmentPath, geometryPath, defines, Build::Blocking);
+	}
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+	//polls an async build, the first call after the driver is done finishes the link on this thread
+	bool isReady()
+	{
+		if (linking && !ProgramCache::Get().IsComplete(ID))
+			return false;
+		if (linking)
+			finishLink();
+		return true;
+	}
 
+	//blocks until an async build is linked
+	void waitReady()
+	{
+		if (linking)
+			finishLink();
 	}
+
 	void use()
 	{
-		glUseProgram(ID);
+		GLState::Get().UseProgram(ID);
 	}
 
 	void setBool(const std::string& name, bool value) const
@@ -114,7 +105,7 @@ public:
 	}
 	void setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(getUniformLocationChecked(name), x, y);
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string& name, const glm::vec3& value) const
@@ -123,7 +114,7 @@ public:
 	}
 	void setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(getUniformLocationChecked(name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string& name, const glm::vec4& value) const
@@ -132,7 +123,7 @@ public:
 	}
 	void setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(getUniformLocationChecked(name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string& name, const glm::mat2& mat) const
@@ -150,7 +141,251 @@ public:
 		glUniformMatrix4fv(getUniformLocationChecked(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
+	// id based setters, resolved through the uniform table built after linking
+	// ------------------------------------------------------------------------
+	void setBool(UniformId id, bool value) const
+	{
+		glUniform1i(findUniformLocation(id), value);
+	}
+	void setInt(UniformId id, int value) const
+	{
+		glUniform1i(findUniformLocation(id), value);
+	}
+	void setFloat(UniformId id, float value) const
+	{
+		glUniform1f(findUniformLocation(id), value);
+	}
+	void setVec2(UniformId id, const glm::vec2& value) const
+	{
+		glUniform2fv(findUniformLocation(id), 1, &value[0]);
+	}
+	void setVec3(UniformId id, const glm::vec3& value) const
+	{
+		glUniform3fv(findUniformLocation(id), 1, &value[0]);
+	}
+	void setVec3(UniformId id, float x, float y, float z) const
+	{
+		glUniform3f(findUniformLocation(id), x, y, z);
+	}
+	void setVec4(UniformId id, const glm::vec4& value) const
+	{
+		glUniform4fv(findUniformLocation(id), 1, &value[0]);
+	}
+	void setMat3(UniformId id, const glm::mat3& mat) const
+	{
+		glUniformMatrix3fv(findUniformLocation(id), 1, GL_FALSE, &mat[0][0]);
+	}
+	void setMat4(UniformId id, const glm::mat4& mat) const
+	{
+		glUniformMatrix4fv(findUniformLocation(id), 1, GL_FALSE, &mat[0][0]);
+	}
+
+	bool hasUniform(UniformId id) const
+	{
+		return findUniformLocation(id) != -1;
+	}
+
+	// attach a named uniform block to a buffer binding point, no-op if the program doesn't use it
+	void bindUniformBlock(const char* blockName, GLuint binding) const
+	{
+		GLuint index = glGetUniformBlockIndex(ID, blockName);
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, index, binding);
+	}
+
 	private:
+		// reads, preprocesses, compiles and links the stages, geometryPath may be null
+		// ------------------------------------------------------------------------
+		void build(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::string& defines, Build mode)
+		{
+			//1.retrieve source code from filepath
+			std::string vertexCode;
+			std::string fragmentCode;
+			std::string geometryCode;
+			std::ifstream vShaderFile;
+			std::ifstream fShaderFile;
+			std::ifstream gShaderFile;
+
+			vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			try
+			{
+				vShaderFile.open(vertexPath);
+				fShaderFile.open(fragmentPath);
+				std::stringstream vShaderStream, fShaderStream;
+
+				vShaderStream << vShaderFile.rdbuf();
+				fShaderStream << fShaderFile.rdbuf();
+
+				vShaderFile.close();
+				fShaderFile.close();
+
+				vertexCode = vShaderStream.str();
+				fragmentCode = fShaderStream.str();
+
+				vertexCode = preprocessSource(vertexCode, vertexPath, defines);
+				fragmentCode = preprocessSource(fragmentCode, fragmentPath, defines);
+
+				if (geometryPath)
+				{
+					gShaderFile.open(geometryPath);
+					std::stringstream gShaderStream;
+					gShaderStream << gShaderFile.rdbuf();
+					gShaderFile.close();
+					geometryCode = preprocessSource(gShaderStream.str(), geometryPath, defines);
+				}
+			}
+			catch (std::ifstream::failure e)
+			{
+				std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+			}
+
+			//2.the same sources on the same driver were linked before, take the binary from the cache
+			ProgramCache& cache = ProgramCache::Get();
+			const std::string sources[] = { vertexCode, fragmentCode, geometryCode };
+			cacheKey = cache.Key(sources, 3);
+			cachePath = cache.PathFor(vertexPath, fragmentPath, geometryPath, defines);
+
+			ID = glCreateProgram();
+			if (cache.Load(ID, cachePath, cacheKey))
+			{
+				LoadedFromCache = true;
+				cacheActiveUniforms();
+				return;
+			}
+			//a binary the driver refused leaves the program in a failed state, start over clean
+			if (cache.BinariesEnabled())
+			{
+				glDeleteProgram(ID);
+				ID = glCreateProgram();
+			}
+
+			//3.Compile Shaders, statuses are only checked in finishLink since asking waits for the compile
+			const char* vShaderCode = vertexCode.c_str();
+			const char* fShaderCode = fragmentCode.c_str();
+
+			vertex = glCreateShader(GL_VERTEX_SHADER);
+			glShaderSource(vertex, 1, &vShaderCode, NULL);
+			glCompileShader(vertex);
+
+			fragment = glCreateShader(GL_FRAGMENT_SHADER);
+			glShaderSource(fragment, 1, &fShaderCode, NULL);
+			glCompileShader(fragment);
+
+			geometry = 0;
+			if (geometryPath)
+			{
+				const char* gShaderCode = geometryCode.c_str();
+				geometry = glCreateShader(GL_GEOMETRY_SHADER);
+				glShaderSource(geometry, 1, &gShaderCode, NULL);
+				glCompileShader(geometry);
+			}
+
+			glAttachShader(ID, vertex);
+			glAttachShader(ID, fragment);
+			if (geometry) glAttachShader(ID, geometry);
+			cache.PrepareLink(ID);
+			glLinkProgram(ID);
+
+			linking = true;
+			if (mode == Build::Blocking)
+				finishLink();
+		}
+
+		// error checks, stage cleanup and the uniform table once the link is done, then the binary goes to the cache
+		// ------------------------------------------------------------------------
+		void finishLink()
+		{
+			linking = false;
+			int success;
+			char infoLog[512];
+
+			glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
+				std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+
+			glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
+				std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+
+			if (geometry)
+			{
+				glGetShaderiv(geometry, GL_COMPILE_STATUS, &success);
+				if (!success)
+				{
+					glGetShaderInfoLog(geometry, 512, nullptr, infoLog);
+					std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n" << infoLog << std::endl;
+				}
+			}
+
+			glGetProgramiv(ID, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				glGetProgramInfoLog(ID, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+			}
+
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			if (geometry) glDeleteShader(geometry);
+
+			cacheActiveUniforms();
+			if (success)
+				ProgramCache::Get().Store(ID, cachePath, cacheKey);
+		}
+
+		// resolves #include "file" (relative to the including file) and injects defines after #version
+		// ------------------------------------------------------------------------
+		static std::string preprocessSource(const std::string& source, const std::string& path, const std::string& defines)
+		{
+			std::string directory;
+			size_t slash = path.find_last_of("/\\");
+			if (slash != std::string::npos)
+				directory = path.substr(0, slash + 1);
+
+			std::stringstream in(source);
+			std::string out, line;
+			while (std::getline(in, line))
+			{
+				size_t start = line.find_first_not_of(" \t");
+				if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+				{
+					size_t open = line.find('"', start);
+					size_t close = line.find('"', open + 1);
+					std::string includePath = directory + line.substr(open + 1, close - open - 1);
+
+					std::ifstream includeFile;
+					includeFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+					includeFile.open(includePath);
+					std::stringstream includeStream;
+					includeStream << includeFile.rdbuf();
+
+					out += preprocessSource(includeStream.str(), includePath, "");
+					continue;
+				}
+
+				out += line;
+				out += '\n';
+				if (start != std::string::npos && line.compare(start, 8, "#version") == 0)
+					out += defines;
+			}
+			return out;
+		}
+
+		// async build state, the stages live until finishLink
+		// ------------------------------------------------------------------------
+		unsigned int vertex = 0, fragment = 0, geometry = 0;
+		bool linking = false;
+		uint64_t cacheKey = 0;
+		std::string cachePath;
+
 		// utility function for checking shader compilation/linking errors.
 		// ------------------------------------------------------------------------
 		void checkCompileErrors(GLuint shader, std::string type)
@@ -179,13 +414,105 @@ public:
 
 		GLint getUniformLocationChecked(const std::string& name) const
 		{
-			GLint location = glGetUniformLocation(ID, name.c_str());
+			GLint location = findUniformLocation(UniformName(name.c_str()));
 			if (location == -1)
 			{
 				std::cerr << "⚠️  Warning: Uniform '" << name << "' not found or unused in shader program (ID: " << ID << ").\n";
 			}
 			return location;
 		}
+
+		// uniform table: open addressing keyed by name hash, filled once after linking
+		// both hashes have to match, names sharing the probe hash just take the next free slot
+		// ------------------------------------------------------------------------
+		std::vector<unsigned int> uniformHashes;
+		std::vector<unsigned int> uniformChecks;
+		std::vector<GLint> uniformLocations;
+		unsigned int uniformMask = 0;
+
+		GLint findUniformLocation(UniformId id) const
+		{
+			if (uniformHashes.empty())
+				return -1;
+
+			unsigned int hash = id.hash == 0 ? 1 : id.hash;
+			for (unsigned int slot = hash & uniformMask;; slot = (slot + 1) & uniformMask)
+			{
+				if (uniformHashes[slot] == hash && uniformChecks[slot] == id.check)
+					return uniformLocations[slot];
+				if (uniformHashes[slot] == 0)
+					return -1;
+			}
+		}
+
+		void insertUniform(const std::string& name, GLint location)
+		{
+			UniformId id = UniformName(name.c_str());
+			unsigned int hash = id.hash == 0 ? 1 : id.hash;
+
+			unsigned int slot = hash & uniformMask;
+			while (uniformHashes[slot] != 0)
+			{
+				if (uniformHashes[slot] == hash && uniformChecks[slot] == id.check)
+				{
+					//both hashes equal, there's no telling the two apart: neither resolves rather than one writing the other
+					std::cerr << "Warning: uniform '" << name << "' collides with another uniform hash in shader program (ID: " << ID << "), both are unreachable by name.\n";
+					uniformLocations[slot] = -1;
+					return;
+				}
+				slot = (slot + 1) & uniformMask;
+			}
+			uniformHashes[slot] = hash;
+			uniformChecks[slot] = id.check;
+			uniformLocations[slot] = location;
+		}
+
+		void cacheActiveUniforms()
+		{
+			GLint count = 0, maxLength = 0;
+			glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+			//collect names first, arrays register "name", "name[0]" and every other element
+			std::vector<std::pair<std::string, GLint>> entries;
+			std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+			for (GLint i = 0; i < count; i++)
+			{
+				GLsizei length = 0;
+				GLint size = 0;
+				GLenum type = 0;
+				glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+				std::string name(nameBuffer.data(), length);
+				GLint location = glGetUniformLocation(ID, name.c_str());
+				if (location == -1) //block members have no location
+					continue;
+
+				entries.emplace_back(name, location);
+
+				if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				{
+					std::string base = name.substr(0, name.size() - 3);
+					entries.emplace_back(base, location);
+					for (GLint element = 1; element < size; element++)
+					{
+						std::string elementName = base + "[" + std::to_string(element) + "]";
+						entries.emplace_back(elementName, glGetUniformLocation(ID, elementName.c_str()));
+					}
+				}
+			}
+
+			unsigned int capacity = 16;
+			while (capacity < entries.size() * 2)
+				capacity *= 2;
+
+			uniformMask = capacity - 1;
+			uniformHashes.assign(capacity, 0);
+			uniformChecks.assign(capacity, 0);
+			uniformLocations.assign(capacity, -1);
+			for (const auto& entry : entries)
+				insertUniform(entry.first, entry.second);
+		}
 };
 
 #endif
\ No newline at end of file
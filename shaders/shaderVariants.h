@@ -0,0 +1,125 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "shader.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//one vertex/fragment pair compiled once per feature set, bit i of a feature mask injects "#define <featureNames[i]>"
+//a variant is built the first time its mask is asked for and kept, after that picking it per draw is a hash lookup
+//new variants build async: while the driver compiles one, Get hands out a finished variant that agrees on the
+//FallbackMatch bits (e.g. the vertex layout), and only waits when there is none
+class ShaderVariants
+{
+public:
+	//runs once on every new variant, for the per program state (sampler units, uniform block bindings)
+	typedef std::function<void(Shader&)> SetupFunction;
+
+	size_t CompiledCount = 0;
+	double CompileMilliseconds = 0.0;		//spent on this thread, parallel compiles mostly happen in the driver
+	int FallbackUses = 0;
+
+	//features a stand-in variant has to share with the one asked for, all of them by default (no fallback)
+	uint32_t FallbackMatch = 0xFFFFFFFFu;
+
+	//supported masks out the features this source doesn't use, so one mask can be handed to every set
+	//without compiling identical programs for bits that change nothing
+	ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<const char*>& featureNames, uint32_t supported,
+		const std::string& baseDefines = "", SetupFunction setup = nullptr)
+		: vertexPath(vertexPath), fragmentPath(fragmentPath), featureNames(featureNames), supported(supported),
+		baseDefines(baseDefines), setup(setup)
+	{
+	}
+
+	//starts a variant without waiting for it, several prepared ones compile side by side in the driver
+	void Prepare(uint32_t features)
+	{
+		find(features & supported);
+	}
+
+	Shader& Get(uint32_t features)
+	{
+		features &= supported;
+		Variant& variant = find(features);
+		if (variant.ready)
+			return *variant.shader;
+
+		if (!variant.shader->isReady()) {
+			for (auto& other : variants) {
+				if (other.second.ready && (other.first & FallbackMatch) == (features & FallbackMatch)) {
+					FallbackUses++;
+					return *other.second.shader;
+				}
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		variant.shader->waitReady();
+		if (setup)
+			setup(*variant.shader);
+		CompileMilliseconds += elapsedMilliseconds(start);
+		variant.ready = true;
+		return *variant.shader;
+	}
+
+	//variants still compiling in the driver
+	size_t PendingCount() const
+	{
+		size_t pending = 0;
+		for (const auto& variant : variants)
+			pending += variant.second.ready ? 0 : 1;
+		return pending;
+	}
+
+	//the define block a mask stands for, the base defines first and then one line per set bit
+	std::string Defines(uint32_t features) const
+	{
+		std::string defines = baseDefines;
+		features &= supported;
+		for (size_t i = 0; i < featureNames.size(); i++)
+			if (features & (1u << i))
+				defines += std::string("#define ") + featureNames[i] + "\n";
+		return defines;
+	}
+
+private:
+	struct Variant {
+		std::unique_ptr<Shader> shader;
+		bool ready = false;		//linked and set up
+	};
+
+	Variant& find(uint32_t features)
+	{
+		auto found = variants.find(features);
+		if (found != variants.end())
+			return found->second;
+
+		auto start = std::chrono::steady_clock::now();
+		Variant variant;
+		variant.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), Defines(features), Shader::Build::Async));
+		CompileMilliseconds += elapsedMilliseconds(start);
+		CompiledCount++;
+		return variants.emplace(features, std::move(variant)).first->second;
+	}
+
+	static double elapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<const char*> featureNames;
+	uint32_t supported;
+	std::string baseDefines;
+	SetupFunction setup;
+	std::unordered_map<uint32_t, Variant> variants;
+};
+
+#endif
@@ -2,19 +2,36 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+
+#ifdef INSTANCED
+// per instance attributes, see renderer/instanceBuffer.h
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in mat3 aNormalMatrix;
+layout (location = 10) in vec3 aColor;
+
+out vec3 InstanceColor;
+#else
+uniform mat4 model;
+// inverse-transpose of model, computed once per object on the CPU (math/normalMatrix.h)
+uniform mat3 normalMatrix;
+#endif
   
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aModel;
+    mat3 normalMatrix = aNormalMatrix;
+    InstanceColor = aColor;
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = vec3(model * vec4(aPos,1.0));
-    Normal = mat3(transpose(inverse(model))) *  aNormal;
+    Normal = normalMatrix *  aNormal;
    TexCoord = aTexCoord;
-}
\ No newline at end of file
+}